@@ -12,6 +12,7 @@
  * General Public License for more details.
  */
 
+#include <SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,6 +20,7 @@
 #include <assert.h>
 
 #include "demo.h"
+#include "vec3.h"
 #include "audio.h"
 #include "config.h"
 #include "binary.h"
@@ -26,17 +28,16 @@
 #include "level.h"
 #include "array.h"
 #include "dir.h"
+#include "log.h"
+#include "queue.h"
+#include "solid_vary.h"
+#include "cmd.h"
 
 #include "game_server.h"
 #include "game_client.h"
 #include "game_proxy.h"
 #include "game_common.h"
 
-#define DEMO_MAGIC (0xAF | 'N' << 8 | 'B' << 16 | 'R' << 24)
-#define DEMO_VERSION 9
-
-#define DATELEN sizeof ("YYYY-MM-DDTHH:MM:SS")
-
 fs_file demo_fp;
 
 /*---------------------------------------------------------------------------*/
@@ -57,90 +58,6 @@ static const char *demo_name(const char *path)
 
 /*---------------------------------------------------------------------------*/
 
-static int demo_header_read(fs_file fp, struct demo *d)
-{
-    int magic;
-    int version;
-    int t;
-
-    struct tm date;
-    char datestr[DATELEN];
-
-    magic   = get_index(fp);
-    version = get_index(fp);
-
-    t = get_index(fp);
-
-    if (magic == DEMO_MAGIC && version == DEMO_VERSION && t)
-    {
-        d->timer = t;
-
-        d->coins  = get_index(fp);
-        d->status = get_index(fp);
-        d->mode   = get_index(fp);
-
-        get_string(fp, d->player, sizeof (d->player));
-        get_string(fp, datestr, sizeof (datestr));
-
-        sscanf(datestr,
-               "%d-%d-%dT%d:%d:%d",
-               &date.tm_year,
-               &date.tm_mon,
-               &date.tm_mday,
-               &date.tm_hour,
-               &date.tm_min,
-               &date.tm_sec);
-
-        date.tm_year -= 1900;
-        date.tm_mon  -= 1;
-        date.tm_isdst = -1;
-
-        d->date = make_time_from_utc(&date);
-
-        get_string(fp, d->shot, PATHMAX);
-        get_string(fp, d->file, PATHMAX);
-
-        d->time  = get_index(fp);
-        d->goal  = get_index(fp);
-        (void)     get_index(fp);
-        d->score = get_index(fp);
-        d->balls = get_index(fp);
-        d->times = get_index(fp);
-
-        return 1;
-    }
-    return 0;
-}
-
-static void demo_header_write(fs_file fp, struct demo *d)
-{
-    char datestr[DATELEN];
-
-    strftime(datestr, sizeof (datestr), "%Y-%m-%dT%H:%M:%S", gmtime(&d->date));
-
-    put_index(fp, DEMO_MAGIC);
-    put_index(fp, DEMO_VERSION);
-    put_index(fp, 0);
-    put_index(fp, 0);
-    put_index(fp, 0);
-    put_index(fp, d->mode);
-
-    put_string(fp, d->player);
-    put_string(fp, datestr);
-
-    put_string(fp, d->shot);
-    put_string(fp, d->file);
-
-    put_index(fp, d->time);
-    put_index(fp, d->goal);
-    put_index(fp, 0);                   /* Unused (was goal enabled flag).   */
-    put_index(fp, d->score);
-    put_index(fp, d->balls);
-    put_index(fp, d->times);
-}
-
-/*---------------------------------------------------------------------------*/
-
 int demo_load(struct demo *d, const char *path)
 {
     int rc = 0;
@@ -266,6 +183,173 @@ const char *demo_format_name(const char *fmt,
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Replay recorder. Commands are collected into blocks on the main thread
+ * and a writer thread serialises them to the replay file, so that file
+ * system stalls stay off the main thread. A block is handed over at the
+ * end of each update, and the file is flushed about once a second.
+ */
+
+#define REC_FLUSH 90                    /* Blocks between flushes            */
+
+static SDL_Thread *rec_thread;
+static SDL_mutex  *rec_mutex;
+static SDL_cond   *rec_cond;
+static int         rec_stop;
+
+static Queue rec_full;                  /* Blocks waiting to be written      */
+static Queue rec_block;                 /* Block being filled                */
+
+static int rec_stat_e;                  /* Pending header update flag        */
+static int rec_stat[3];                 /* Pending timer, coins and status   */
+
+static int rec_blocks;                  /* Blocks written                    */
+
+static void rec_write_stat(const int *stat)
+{
+    long pos = fs_tell(demo_fp);
+
+    fs_seek(demo_fp, 8, SEEK_SET);
+
+    put_index(demo_fp, stat[0]);
+    put_index(demo_fp, stat[1]);
+    put_index(demo_fp, stat[2]);
+
+    fs_seek(demo_fp, pos, SEEK_SET);
+    fs_flush(demo_fp);
+}
+
+static void rec_write(Queue block)
+{
+    union cmd *cmdp;
+
+    while ((cmdp = queue_deq(block)))
+    {
+        cmd_put(demo_fp, cmdp);
+        cmd_free(cmdp);
+    }
+    queue_free(block);
+
+    if (++rec_blocks % REC_FLUSH == 0)
+        fs_flush(demo_fp);
+}
+
+static int rec_func(void *data)
+{
+    Queue block;
+    int stat[3];
+
+    SDL_LockMutex(rec_mutex);
+
+    while (1)
+    {
+        /* Write out all waiting blocks, then any header update. */
+
+        if ((block = queue_deq(rec_full)))
+        {
+            SDL_UnlockMutex(rec_mutex);
+            rec_write(block);
+            SDL_LockMutex(rec_mutex);
+        }
+        else if (rec_stat_e)
+        {
+            memcpy(stat, rec_stat, sizeof (stat));
+            rec_stat_e = 0;
+
+            SDL_UnlockMutex(rec_mutex);
+            rec_write_stat(stat);
+            SDL_LockMutex(rec_mutex);
+        }
+        else if (rec_stop)
+            break;
+        else
+            SDL_CondWait(rec_cond, rec_mutex);
+    }
+
+    SDL_UnlockMutex(rec_mutex);
+
+    return 0;
+}
+
+static void rec_init(void)
+{
+    /* These are created once and kept for the life of the program. */
+
+    if (!rec_mutex) rec_mutex = SDL_CreateMutex();
+    if (!rec_cond)  rec_cond  = SDL_CreateCond();
+    if (!rec_full)  rec_full  = queue_new();
+
+    rec_block  = queue_new();
+    rec_blocks = 0;
+    rec_stat_e = 0;
+    rec_stop   = 0;
+
+    if (!rec_mutex || !rec_cond || !rec_full ||
+        !(rec_thread = SDL_CreateThread(rec_func, "replay", NULL)))
+        log_printf("Failure to start replay writer (%s)\n", SDL_GetError());
+}
+
+/*
+ * Hand the block being filled over to the writer, or write it out here
+ * if there is no writer.
+ */
+static void rec_hand(void)
+{
+    if (rec_thread)
+    {
+        SDL_LockMutex(rec_mutex);
+        queue_enq(rec_full, rec_block);
+        SDL_CondSignal(rec_cond);
+        SDL_UnlockMutex(rec_mutex);
+    }
+    else rec_write(rec_block);
+
+    rec_block = queue_new();
+}
+
+static void rec_quit(void)
+{
+    if (rec_block)
+    {
+        rec_hand();
+
+        queue_free(rec_block);
+        rec_block = NULL;
+    }
+
+    if (rec_thread)
+    {
+        SDL_LockMutex(rec_mutex);
+        rec_stop = 1;
+        SDL_CondSignal(rec_cond);
+        SDL_UnlockMutex(rec_mutex);
+
+        SDL_WaitThread(rec_thread, NULL);
+        rec_thread = NULL;
+    }
+
+    if (config_get_d(CONFIG_STATS))
+        fprintf(stdout, "%-8s %7ld B %5d blocks\n", "record",
+                fs_tell(demo_fp), rec_blocks);
+}
+
+/*
+ * Record a command generated during play. Takes ownership of CMDP.
+ */
+void demo_play_cmd(union cmd *cmdp)
+{
+    if (demo_fp && rec_block)
+    {
+        queue_enq(rec_block, cmdp);
+
+        if (cmdp->type == CMD_END_OF_UPDATE)
+            rec_hand();
+    }
+    else cmd_free(cmdp);
+}
+
+/*---------------------------------------------------------------------------*/
+
 static struct demo demo_play;
 
 int demo_play_init(const char *name, const struct level *level,
@@ -292,6 +376,7 @@ int demo_play_init(const char *name, const struct level *level,
     if ((demo_fp = fs_open(d->path, "w")))
     {
         demo_header_write(demo_fp, d);
+        rec_init();
         return 1;
     }
     return 0;
@@ -301,15 +386,23 @@ void demo_play_stat(int status, int coins, int timer)
 {
     if (demo_fp)
     {
-        long pos = fs_tell(demo_fp);
+        int stat[3];
 
-        fs_seek(demo_fp, 8, SEEK_SET);
+        stat[0] = timer;
+        stat[1] = coins;
+        stat[2] = status;
 
-        put_index(demo_fp, timer);
-        put_index(demo_fp, coins);
-        put_index(demo_fp, status);
+        /* The writer applies this once it has caught up. */
 
-        fs_seek(demo_fp, pos, SEEK_SET);
+        if (rec_thread)
+        {
+            SDL_LockMutex(rec_mutex);
+            memcpy(rec_stat, stat, sizeof (stat));
+            rec_stat_e = 1;
+            SDL_CondSignal(rec_cond);
+            SDL_UnlockMutex(rec_mutex);
+        }
+        else rec_write_stat(stat);
     }
 }
 
@@ -317,6 +410,8 @@ void demo_play_stop(int d)
 {
     if (demo_fp)
     {
+        rec_quit();
+
         fs_close(demo_fp);
         demo_fp = NULL;
 
@@ -375,7 +470,7 @@ static void demo_update_read(float dt)
     }
 }
 
-static struct lockstep update_step = { demo_update_read, DT };
+static struct lockstep update_step = { demo_update_read, DT, "replay" };
 
 float demo_replay_blend(void)
 {
@@ -473,3 +568,183 @@ void demo_replay_speed(int speed)
 }
 
 /*---------------------------------------------------------------------------*/
+
+/*
+ * Ghost replay. A second replay is read alongside live play, with only its
+ * ball decoded and interpolated. It shares no state with the replay above
+ * and the game proxy, and it allocates nothing once opened.
+ */
+
+static fs_file       ghost_fp;
+static int           ghost_ui;          /* Current ball of the replay        */
+static struct l_ball ghost_ball[2];     /* Current and previous ball         */
+
+static unsigned char ghost_keep[CMD_MAX];
+
+static struct lockstep ghost_step;
+
+static int ghost_read(void)
+{
+    struct l_ball *up = &ghost_ball[0];
+    union cmd cmd;
+
+    ghost_ball[1] = ghost_ball[0];
+
+    while (cmd_get_only(ghost_fp, &cmd, ghost_keep))
+    {
+        switch (cmd.type)
+        {
+        case CMD_END_OF_UPDATE:
+            return 1;
+
+        case CMD_UPDATES_PER_SECOND:
+            if (cmd.ups.n > 0)
+                ghost_step.dt = 1.0f / cmd.ups.n;
+            break;
+
+        case CMD_CURRENT_BALL:
+            ghost_ui = cmd.currball.ui;
+            break;
+
+        case CMD_BALL_RADIUS:
+            if (ghost_ui == 0)
+                up->r = cmd.ballradius.r;
+            break;
+
+        case CMD_BALL_POSITION:
+            if (ghost_ui == 0)
+                v_cpy(up->p, cmd.ballpos.p);
+            break;
+
+        case CMD_BALL_BASIS:
+            if (ghost_ui == 0)
+            {
+                v_cpy(up->e[0], cmd.ballbasis.e[0]);
+                v_cpy(up->e[1], cmd.ballbasis.e[1]);
+                v_crs(up->e[2], up->e[0], up->e[1]);
+            }
+            break;
+
+        case CMD_BALL_PEND_BASIS:
+            if (ghost_ui == 0)
+            {
+                v_cpy(up->E[0], cmd.ballpendbasis.E[0]);
+                v_cpy(up->E[1], cmd.ballpendbasis.E[1]);
+                v_crs(up->E[2], up->E[0], up->E[1]);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+    return 0;
+}
+
+static void ghost_update(float dt)
+{
+    if (ghost_fp && !ghost_read())
+        demo_ghost_stop();
+}
+
+static struct lockstep ghost_step = { ghost_update, DT, "ghost" };
+
+/*
+ * Open the named replay as a ghost, provided it was recorded on FILE. The
+ * user replay is refused, as it is being rewritten by the current play.
+ */
+int demo_ghost_init(const char *name, const char *file)
+{
+    struct demo d;
+
+    demo_ghost_stop();
+
+    if (!name || !*name || !file)
+        return 0;
+
+    if (strcmp(name, USER_REPLAY_FILE) == 0)
+    {
+        log_printf("Ghost replay cannot be \"%s\"\n", USER_REPLAY_FILE);
+        return 0;
+    }
+
+    if ((ghost_fp = fs_open(demo_path(name), "r")))
+    {
+        if (demo_header_read(ghost_fp, &d) && strcmp(d.file, file) == 0)
+        {
+            static const struct l_ball ball = {
+                {{ 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }},
+                {  0.0f, 0.0f, 0.0f },
+                {{ 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }},
+                0.0f
+            };
+
+            memset(ghost_keep, 0, sizeof (ghost_keep));
+
+            ghost_keep[CMD_END_OF_UPDATE]      = 1;
+            ghost_keep[CMD_UPDATES_PER_SECOND] = 1;
+            ghost_keep[CMD_CURRENT_BALL]       = 1;
+            ghost_keep[CMD_BALL_RADIUS]        = 1;
+            ghost_keep[CMD_BALL_POSITION]      = 1;
+            ghost_keep[CMD_BALL_BASIS]         = 1;
+            ghost_keep[CMD_BALL_PEND_BASIS]    = 1;
+
+            ghost_ui      = 0;
+            ghost_ball[0] = ball;
+
+            lockstep_clr(&ghost_step);
+
+            /* Read the initial state and hold it as the previous state. */
+
+            if (ghost_read())
+            {
+                ghost_ball[1] = ghost_ball[0];
+                return 1;
+            }
+        }
+
+        fs_close(ghost_fp);
+        ghost_fp = NULL;
+    }
+    return 0;
+}
+
+void demo_ghost_step(float dt)
+{
+    if (ghost_fp)
+        lockstep_run(&ghost_step, dt);
+}
+
+void demo_ghost_stop(void)
+{
+    if (ghost_fp)
+    {
+        fs_close(ghost_fp);
+        ghost_fp = NULL;
+    }
+}
+
+/*
+ * Interpolate the ghost ball at the current point between updates.
+ */
+int demo_ghost_ball(struct v_ball *up)
+{
+    if (ghost_fp)
+    {
+        const struct l_ball *curr = &ghost_ball[0];
+        const struct l_ball *prev = &ghost_ball[1];
+
+        float a = lockstep_blend(&ghost_step);
+
+        e_lerp(up->e, prev->e, curr->e, a);
+        v_lerp(up->p, prev->p, curr->p, a);
+        e_lerp(up->E, prev->E, curr->E, a);
+
+        up->r = flerp(prev->r, curr->r, a);
+
+        return (up->r > 0.0f);
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
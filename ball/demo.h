@@ -44,11 +44,17 @@ const char *demo_format_name(const char *fmt,
                              const char *set,
                              const char *level);
 
+int  demo_header_read (fs_file, struct demo *);
+void demo_header_write(fs_file, struct demo *);
+
 /*---------------------------------------------------------------------------*/
 
+union cmd;
+
 int  demo_play_init(const char *, const struct level *, int, int, int, int);
 void demo_play_step(void);
 void demo_play_stat(int, int, int);
+void demo_play_cmd(union cmd *);
 void demo_play_stop(int);
 
 int  demo_saved (void);
@@ -69,6 +75,15 @@ void demo_replay_speed(int);
 
 /*---------------------------------------------------------------------------*/
 
+struct v_ball;
+
+int  demo_ghost_init(const char *, const char *);
+void demo_ghost_step(float);
+void demo_ghost_stop(void);
+int  demo_ghost_ball(struct v_ball *);
+
+/*---------------------------------------------------------------------------*/
+
 extern fs_file demo_fp;
 
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2003 Robert Kooima
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "demo.h"
+#include "binary.h"
+#include "common.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define DEMO_MAGIC (0xAF | 'N' << 8 | 'B' << 16 | 'R' << 24)
+#define DEMO_VERSION 9
+
+#define DATELEN sizeof ("YYYY-MM-DDTHH:MM:SS")
+
+/*---------------------------------------------------------------------------*/
+
+int demo_header_read(fs_file fp, struct demo *d)
+{
+    int magic;
+    int version;
+    int t;
+
+    struct tm date;
+    char datestr[DATELEN];
+
+    magic   = get_index(fp);
+    version = get_index(fp);
+
+    t = get_index(fp);
+
+    if (magic == DEMO_MAGIC && version == DEMO_VERSION && t)
+    {
+        d->timer = t;
+
+        d->coins  = get_index(fp);
+        d->status = get_index(fp);
+        d->mode   = get_index(fp);
+
+        get_string(fp, d->player, sizeof (d->player));
+        get_string(fp, datestr, sizeof (datestr));
+
+        sscanf(datestr,
+               "%d-%d-%dT%d:%d:%d",
+               &date.tm_year,
+               &date.tm_mon,
+               &date.tm_mday,
+               &date.tm_hour,
+               &date.tm_min,
+               &date.tm_sec);
+
+        date.tm_year -= 1900;
+        date.tm_mon  -= 1;
+        date.tm_isdst = -1;
+
+        d->date = make_time_from_utc(&date);
+
+        get_string(fp, d->shot, PATHMAX);
+        get_string(fp, d->file, PATHMAX);
+
+        d->time  = get_index(fp);
+        d->goal  = get_index(fp);
+        (void)     get_index(fp);
+        d->score = get_index(fp);
+        d->balls = get_index(fp);
+        d->times = get_index(fp);
+
+        return 1;
+    }
+    return 0;
+}
+
+void demo_header_write(fs_file fp, struct demo *d)
+{
+    char datestr[DATELEN];
+
+    strftime(datestr, sizeof (datestr), "%Y-%m-%dT%H:%M:%S", gmtime(&d->date));
+
+    put_index(fp, DEMO_MAGIC);
+    put_index(fp, DEMO_VERSION);
+    put_index(fp, 0);
+    put_index(fp, 0);
+    put_index(fp, 0);
+    put_index(fp, d->mode);
+
+    put_string(fp, d->player);
+    put_string(fp, datestr);
+
+    put_string(fp, d->shot);
+    put_string(fp, d->file);
+
+    put_index(fp, d->time);
+    put_index(fp, d->goal);
+    put_index(fp, 0);                   /* Unused (was goal enabled flag).   */
+    put_index(fp, d->score);
+    put_index(fp, d->balls);
+    put_index(fp, d->times);
+}
+
+/*---------------------------------------------------------------------------*/
@@ -25,6 +25,8 @@
 #include "audio.h"
 #include "config.h"
 #include "video.h"
+#include "prof.h"
+#include "loadtime.h"
 
 #include "solid_draw.h"
 
@@ -47,6 +49,9 @@ int game_compat_map;                    /* Client/server map compat flag     */
 static struct game_draw gd;
 static struct game_lerp gl;
 
+static struct s_vary_snap gd_init;      /* Initial state of the level        */
+static char               gd_file[MAXSTR];
+
 static float timer  = 0.0f;             /* Clock time                        */
 static int   status = GAME_NONE;        /* Outcome of the game               */
 static int   coins  = 0;                /* Collected coins                   */
@@ -325,24 +330,83 @@ static void game_run_cmd(const union cmd *cmd)
     }
 }
 
-void game_client_sync(fs_file demo_fp)
+/*
+ * Run all queued commands, handing each to REC afterwards if given. REC
+ * takes ownership of the command.
+ */
+void game_client_sync(void (*rec)(union cmd *))
 {
     union cmd *cmdp;
 
+    PROF_BEGIN("game_client_sync");
+
     while ((cmdp = game_proxy_deq()))
     {
-        if (demo_fp)
-            cmd_put(demo_fp, cmdp);
-
         game_run_cmd(cmdp);
 
-        cmd_free(cmdp);
+        if (rec)
+            rec(cmdp);
+        else
+            cmd_free(cmdp);
     }
+
+    PROF_END();
 }
 
 /*---------------------------------------------------------------------------*/
 
-int  game_client_init(const char *file_name)
+/*
+ * Initialize the per-attempt client state of the loaded level.
+ */
+static void game_client_start(void)
+{
+    coins  = 0;
+    status = GAME_NONE;
+
+    /* Initialize game state. */
+
+    game_tilt_init(&gd.tilt);
+    game_view_init(&gd.view);
+
+    gd.jump_e  = 1;
+    gd.jump_b  = 0;
+    gd.jump_dt = 0.0f;
+
+    gd.goal_e = 0;
+    gd.goal_k = 0.0f;
+
+    /* Initialize interpolation. */
+
+    game_lerp_init(&gl, &gd);
+
+    /* Initialize fade. */
+
+    gd.fade_k =  1.0f;
+    gd.fade_d = -2.0f;
+
+    /*
+     * If the version of the loaded map is 1, assume we have a version
+     * match with the server.  In this way 1.5.0 replays don't trigger
+     * bogus map compatibility warnings.  Post-1.5.0 replays will have
+     * CMD_MAP override this.
+     */
+
+    game_compat_map = version.x == 1;
+
+    /* Initialize particles. */
+
+    part_reset();
+
+    /* Initialize command state. */
+
+    cmd_state_init(&cs);
+
+    /* Initialize lighting. */
+
+    light_reset();
+}
+
+static int client_init(const char *file_name)
 {
     char *back_name = "", *grad_name = "";
     int i;
@@ -357,41 +421,36 @@ int  game_client_init(const char *file_name)
     if (!game_base_load(file_name))
         return (gd.state = 0);
 
+    loadtime_enter("sol_load_vary");
+
     if (!sol_load_vary(&gd.vary, &game_base))
     {
+        loadtime_leave();
         game_base_free(NULL);
         return (gd.state = 0);
     }
 
+    loadtime_leave();
+    loadtime_enter("sol_load_draw");
+
     if (!sol_load_draw(&gd.draw, &gd.vary, config_get_d(CONFIG_SHADOW)))
     {
+        loadtime_leave();
         sol_free_vary(&gd.vary);
         game_base_free(NULL);
         return (gd.state = 0);
     }
 
-    gd.state = 1;
-
-    /* Initialize game state. */
-
-    game_tilt_init(&gd.tilt);
-    game_view_init(&gd.view);
+    loadtime_leave();
 
-    gd.jump_e  = 1;
-    gd.jump_b  = 0;
-    gd.jump_dt = 0.0f;
+    gd.state = 1;
 
-    gd.goal_e = 0;
-    gd.goal_k = 0.0f;
+    /* Remember the initial state for restarts. */
 
-    /* Initialize interpolation. */
+    if (sol_vary_snap_init(&gd_init, &gd.vary))
+        sol_vary_snapshot(&gd_init, &gd.vary);
 
-    game_lerp_init(&gl, &gd);
-
-    /* Initialize fade. */
-
-    gd.fade_k =  1.0f;
-    gd.fade_d = -2.0f;
+    SAFECPY(gd_file, file_name);
 
     /* Load level info. */
 
@@ -410,33 +469,50 @@ int  game_client_init(const char *file_name)
             sscanf(v, "%d.%d", &version.x, &version.y);
     }
 
-    /*
-     * If the version of the loaded map is 1, assume we have a version
-     * match with the server.  In this way 1.5.0 replays don't trigger
-     * bogus map compatibility warnings.  Post-1.5.0 replays will have
-     * CMD_MAP override this.
-     */
-
-    game_compat_map = version.x == 1;
-
-    /* Initialize particles. */
+    /* Initialize background. */
 
-    part_reset();
+    loadtime_enter("back_init");
+    {
+        back_init(grad_name);
+        sol_load_full(&gd.back, back_name, 0);
+    }
+    loadtime_leave();
 
-    /* Initialize command state. */
+    game_client_start();
 
-    cmd_state_init(&cs);
+    return gd.state;
+}
 
-    /* Initialize background. */
+int  game_client_init(const char *file_name)
+{
+    int rc;
 
-    back_init(grad_name);
-    sol_load_full(&gd.back, back_name, 0);
+    loadtime_enter("game_client_init");
+    rc = client_init(file_name);
+    loadtime_leave();
 
-    /* Initialize lighting. */
+    return rc;
+}
 
-    light_reset();
+/*
+ * Return the loaded level to its initial state, keeping its draw data and
+ * background. Return 0 if the given level is not the one loaded or its
+ * state cannot be restored in place.
+ */
+int  game_client_reset(const char *file_name)
+{
+    if (gd.state && strcmp(gd_file, file_name) == 0)
+    {
+        game_proxy_clr();
 
-    return gd.state;
+        if (sol_vary_restore(&gd.vary, &gd_init))
+        {
+            game_lerp_free(&gl);
+            game_client_start();
+            return 1;
+        }
+    }
+    return 0;
 }
 
 void game_client_free(const char *next)
@@ -449,6 +525,7 @@ void game_client_free(const char *next)
 
         sol_free_draw(&gd.draw);
         sol_free_vary(&gd.vary);
+        sol_vary_snap_free(&gd_init);
 
         game_base_free(next);
 
@@ -474,6 +551,17 @@ void game_client_draw(int pose, float t)
 {
     game_lerp_apply(&gl, &gd);
     game_draw(&gd, pose, t);
+
+    gd.ghost_e = 0;
+}
+
+/*
+ * Draw a ghost ball with the next frame.
+ */
+void game_client_ghost(const struct v_ball *up)
+{
+    if ((gd.ghost_e = (up != NULL)))
+        gd.ghost = *up;
 }
 
 /*---------------------------------------------------------------------------*/
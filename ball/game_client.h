@@ -12,12 +12,19 @@ enum
     POSE_BALL
 };
 
+union cmd;
+
 int   game_client_init(const char *);
+int   game_client_reset(const char *);
 void  game_client_free(const char *);
-void  game_client_sync(fs_file);
+void  game_client_sync(void (*)(union cmd *));
 void  game_client_draw(int, float);
 void  game_client_blend(float);
 
+struct v_ball;
+
+void  game_client_ghost(const struct v_ball *);
+
 int   curr_clock(void);
 int   curr_coins(void);
 int   curr_status(void);
@@ -12,12 +12,20 @@
  * General Public License for more details.
  */
 
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
 #include "game_common.h"
 #include "vec3.h"
 #include "config.h"
 #include "solid_vary.h"
 #include "hmd.h"
 #include "common.h"
+#include "log.h"
+#include "loadtime.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -211,16 +219,68 @@ void lockstep_clr(struct lockstep *ls)
 {
     ls->at = 0;
     ls->ts = 1.0f;
+
+    ls->steps = 0;
+    ls->drops = 0;
+    ls->most  = 0;
+    ls->st    = 0;
 }
 
+/*
+ * Run as many steps as the accumulated time allows, but no more than the
+ * configured number per frame (more when time is sped up). Whole steps
+ * left over after that are either carried into the next frames, up to one
+ * frame's worth, or dropped outright.
+ */
 void lockstep_run(struct lockstep *ls, float dt)
 {
+    int max = config_get_d(CONFIG_STEP_MAX);
+    int n   = 0;
+    int b;
+
     ls->at += dt * ls->ts;
 
-    while (ls->at >= ls->dt)
+    if (max > 0 && ls->ts > 1.0f)
+        max = (int) ceilf(max * ls->ts);
+
+    if ((b = (int) (ls->at / ls->dt)) > ls->most)
+        ls->most = b;
+
+    while (ls->at >= ls->dt && (max <= 0 || n < max))
     {
         ls->step(ls->dt);
         ls->at -= ls->dt;
+        n++;
+    }
+
+    if (max > 0 && ls->at >= ls->dt)
+    {
+        int k = (int) (ls->at / ls->dt);
+
+        if (!config_get_d(CONFIG_STEP_DROP))
+            k -= max;
+
+        if (k > 0)
+        {
+            ls->at    -= k * ls->dt;
+            ls->drops += k;
+        }
+    }
+
+    ls->steps += n;
+
+    /* Report once a second. */
+
+    if ((ls->st += dt) >= 1.0f)
+    {
+        if (config_get_d(CONFIG_STATS))
+            fprintf(stdout, "%-8s %5d %5d %5d\n", ls->name ? ls->name : "step",
+                    ls->steps, ls->drops, ls->most);
+
+        ls->steps = 0;
+        ls->drops = 0;
+        ls->most  = 0;
+        ls->st    = 0;
     }
 }
 
@@ -231,46 +291,327 @@ void lockstep_scl(struct lockstep *ls, float ts)
 
 /*---------------------------------------------------------------------------*/
 
-/* Poor man's cache. */
+/*
+ * Level cache. Parsed SOL files are kept around in least-recently-used
+ * order, up to a count and a memory budget, so that restarting a level or
+ * moving on to a prefetched one skips the file load entirely. The entry in
+ * use is shallow-copied into game_base; entries are only ever written by
+ * the loader, the rest of the game sees read-only geometry.
+ */
+
+#define BASE_MAX   4
+#define BASE_BYTES (32 * 1024 * 1024)
 
-struct s_base  game_base;
-static char   *base_path;
+enum
+{
+    BASE_NONE = 0,
+    BASE_LOADING,
+    BASE_READY
+};
 
-int game_base_load(const char *path)
+struct base_entry
+{
+    char          path[MAXSTR];
+    struct s_base base;
+    size_t        size;
+    unsigned int  time;
+    int           state;
+};
+
+struct s_base game_base;
+
+static struct base_entry bases[BASE_MAX];
+static int               base_curr = -1;
+static unsigned int      base_time;
+
+static SDL_Thread *base_thread;
+static SDL_mutex  *base_mutex;
+static SDL_cond   *base_cond;
+static int         base_stop;
+
+static char base_want[2][MAXSTR];       /* Prefetch requests                 */
+
+static size_t base_size(const struct s_base *fp)
 {
-    if (base_path)
+    return (fp->ac * sizeof (*fp->av) +
+            fp->mc * sizeof (*fp->mv) +
+            fp->vc * sizeof (*fp->vv) +
+            fp->ec * sizeof (*fp->ev) +
+            fp->sc * sizeof (*fp->sv) +
+            fp->tc * sizeof (*fp->tv) +
+            fp->oc * sizeof (*fp->ov) +
+            fp->gc * sizeof (*fp->gv) +
+            fp->lc * sizeof (*fp->lv) +
+            fp->nc * sizeof (*fp->nv) +
+            fp->pc * sizeof (*fp->pv) +
+            fp->bc * sizeof (*fp->bv) +
+            fp->hc * sizeof (*fp->hv) +
+            fp->zc * sizeof (*fp->zv) +
+            fp->jc * sizeof (*fp->jv) +
+            fp->xc * sizeof (*fp->xv) +
+            fp->rc * sizeof (*fp->rv) +
+            fp->uc * sizeof (*fp->uv) +
+            fp->wc * sizeof (*fp->wv) +
+            fp->dc * sizeof (*fp->dv) +
+            fp->ic * sizeof (*fp->iv));
+}
+
+static void base_lock(void)
+{
+    if (base_mutex)
+        SDL_LockMutex(base_mutex);
+}
+
+static void base_unlock(void)
+{
+    if (base_mutex)
+        SDL_UnlockMutex(base_mutex);
+}
+
+static int base_find(const char *path)
+{
+    int i;
+
+    for (i = 0; i < BASE_MAX; i++)
+        if (bases[i].state != BASE_NONE && strcmp(bases[i].path, path) == 0)
+            return i;
+
+    return -1;
+}
+
+/*
+ * Free least recently used entries until a slot is open and the budget
+ * leaves room for the given number of bytes. Return the open slot.
+ */
+static int base_evict(size_t need)
+{
+    size_t total = need;
+    int i, free_i = -1;
+
+    for (i = 0; i < BASE_MAX; i++)
+        if (bases[i].state == BASE_NONE)
+            free_i = i;
+        else
+            total += bases[i].size;
+
+    while (free_i < 0 || total > BASE_BYTES)
     {
-        if (strcmp(base_path, path) == 0)
-            return 1;
+        int lru = -1;
+
+        for (i = 0; i < BASE_MAX; i++)
+            if (bases[i].state == BASE_READY && i != base_curr &&
+                (lru < 0 || bases[i].time < bases[lru].time))
+                lru = i;
 
-        sol_free_base(&game_base);
+        if (lru < 0)
+            break;
 
-        free(base_path);
-        base_path = NULL;
+        sol_free_base(&bases[lru].base);
+
+        total -= bases[lru].size;
+
+        memset(&bases[lru], 0, sizeof (bases[lru]));
+        free_i = lru;
     }
 
-    if (sol_load_base(&game_base, path))
+    return free_i;
+}
+
+/*
+ * Load the given path into a new entry. The lock is held on entry and
+ * exit but released during the load itself.
+ */
+static int base_fill(const char *path)
+{
+    struct s_base base;
+    int i, ok;
+
+    if ((i = base_evict(0)) < 0)
+        return -1;
+
+    SAFECPY(bases[i].path, path);
+    bases[i].state = BASE_LOADING;
+
+    base_unlock();
+    ok = sol_load_base(&base, path);
+    base_lock();
+
+    if (ok)
     {
-        base_path = strdup(path);
-        return 1;
+        bases[i].base  = base;
+        bases[i].size  = base_size(&base);
+        bases[i].time  = ++base_time;
+        bases[i].state = BASE_READY;
+        base_evict(0);
+    }
+    else
+        memset(&bases[i], 0, sizeof (bases[i]));
+
+    if (base_cond)
+        SDL_CondBroadcast(base_cond);
+
+    return ok ? i : -1;
+}
+
+static int base_func(void *data)
+{
+    base_lock();
+
+    while (!base_stop)
+    {
+        int i;
+
+        for (i = 0; i < ARRAYSIZE(base_want); i++)
+            if (base_want[i][0])
+            {
+                char path[MAXSTR];
+
+                SAFECPY(path, base_want[i]);
+                base_want[i][0] = 0;
+
+                if (base_find(path) < 0)
+                    base_fill(path);
+                break;
+            }
+
+        if (i == ARRAYSIZE(base_want))
+            SDL_CondWait(base_cond, base_mutex);
     }
 
+    base_unlock();
     return 0;
 }
 
+void game_base_init(void)
+{
+    if ((base_mutex = SDL_CreateMutex()))
+    {
+        if ((base_cond = SDL_CreateCond()))
+        {
+            base_stop = 0;
+
+            if ((base_thread = SDL_CreateThread(base_func, "level", NULL)))
+                return;
+
+            SDL_DestroyCond(base_cond);
+            base_cond = NULL;
+        }
+        SDL_DestroyMutex(base_mutex);
+        base_mutex = NULL;
+    }
+
+    log_printf("Level prefetch disabled (%s)\n", SDL_GetError());
+}
+
+void game_base_quit(void)
+{
+    int i;
+
+    if (base_thread)
+    {
+        base_lock();
+        base_stop = 1;
+        SDL_CondBroadcast(base_cond);
+        base_unlock();
+
+        SDL_WaitThread(base_thread, NULL);
+        base_thread = NULL;
+
+        SDL_DestroyCond(base_cond);
+        SDL_DestroyMutex(base_mutex);
+
+        base_cond  = NULL;
+        base_mutex = NULL;
+    }
+
+    for (i = 0; i < BASE_MAX; i++)
+        if (bases[i].state == BASE_READY)
+            sol_free_base(&bases[i].base);
+
+    memset(bases, 0, sizeof (bases));
+    memset(&game_base, 0, sizeof (game_base));
+
+    base_curr = -1;
+}
+
+int game_base_load(const char *path)
+{
+    int i;
+
+    if (base_curr >= 0 && strcmp(bases[base_curr].path, path) == 0)
+        return 1;
+
+    loadtime_enter("game_base_load");
+    base_lock();
+
+    /* Wait out a prefetch of the same file, if any. */
+
+    while ((i = base_find(path)) >= 0 && bases[i].state == BASE_LOADING)
+        SDL_CondWait(base_cond, base_mutex);
+
+    if (i < 0)
+        i = base_fill(path);
+
+    if (i >= 0)
+    {
+        bases[i].time = ++base_time;
+        game_base     = bases[i].base;
+        base_curr     = i;
+    }
+
+    base_unlock();
+    loadtime_leave();
+
+    return (i >= 0);
+}
 
 void game_base_free(const char *next)
 {
-    if (base_path)
+    if (base_curr >= 0)
     {
-        if (next && strcmp(base_path, next) == 0)
+        if (next && strcmp(bases[base_curr].path, next) == 0)
             return;
 
-        sol_free_base(&game_base);
+        base_lock();
+        memset(&game_base, 0, sizeof (game_base));
+        base_curr = -1;
+        base_unlock();
+    }
+}
+
+/*
+ * Queue a background load of the given level file.
+ */
+void game_base_prefetch(const char *path)
+{
+    int i;
+
+    if (!base_thread || !path || !*path)
+        return;
+
+    base_lock();
 
-        free(base_path);
-        base_path = NULL;
+    if ((i = base_find(path)) >= 0)
+        bases[i].time = ++base_time;
+    else
+    {
+        for (i = 0; i < ARRAYSIZE(base_want); i++)
+            if (strcmp(base_want[i], path) == 0)
+                break;
+
+        if (i == ARRAYSIZE(base_want))
+        {
+            for (i = 0; i < ARRAYSIZE(base_want); i++)
+                if (!base_want[i][0])
+                {
+                    SAFECPY(base_want[i], path);
+                    break;
+                }
+        }
+        SDL_CondSignal(base_cond);
     }
+
+    base_unlock();
 }
 
 /*---------------------------------------------------------------------------*/
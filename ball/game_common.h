@@ -107,8 +107,14 @@ struct lockstep
     void (*step)(float);
 
     float dt;                           /* Time step length                  */
+    const char *name;                   /* Label in statistics output        */
     float at;                           /* Accumulator                       */
     float ts;                           /* Time scale factor                 */
+
+    int   steps;                        /* Steps run since last report       */
+    int   drops;                        /* Steps dropped since last report   */
+    int   most;                         /* Largest backlog since last report */
+    float st;                           /* Time since last report            */
 };
 
 void lockstep_clr(struct lockstep *);
@@ -121,8 +127,12 @@ void lockstep_scl(struct lockstep *, float);
 
 extern struct s_base game_base;
 
+void game_base_init(void);
+void game_base_quit(void);
+
 int  game_base_load(const char *);
 void game_base_free(const char *);
+void game_base_prefetch(const char *);
 
 /*---------------------------------------------------------------------------*/
 
@@ -19,6 +19,7 @@
 #include "geom.h"
 #include "config.h"
 #include "video.h"
+#include "prof.h"
 
 #include "solid_draw.h"
 
@@ -26,26 +27,25 @@
 
 /*---------------------------------------------------------------------------*/
 
-static void game_draw_balls(struct s_rend *rend,
-                            const struct s_vary *vary,
-                            const float *bill_M, float t)
+static void game_draw_ball(struct s_rend *rend,
+                           const struct v_ball *up,
+                           const float *c,
+                           const float *bill_M, float t)
 {
-    float c[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
-
     float ball_M[16];
     float pend_M[16];
 
-    m_basis(ball_M, vary->uv[0].e[0], vary->uv[0].e[1], vary->uv[0].e[2]);
-    m_basis(pend_M, vary->uv[0].E[0], vary->uv[0].E[1], vary->uv[0].E[2]);
+    m_basis(ball_M, up->e[0], up->e[1], up->e[2]);
+    m_basis(pend_M, up->E[0], up->E[1], up->E[2]);
 
     glPushMatrix();
     {
-        glTranslatef(vary->uv[0].p[0],
-                     vary->uv[0].p[1] + BALL_FUDGE,
-                     vary->uv[0].p[2]);
-        glScalef(vary->uv[0].r,
-                 vary->uv[0].r,
-                 vary->uv[0].r);
+        glTranslatef(up->p[0],
+                     up->p[1] + BALL_FUDGE,
+                     up->p[2]);
+        glScalef(up->r,
+                 up->r,
+                 up->r);
 
         glColor4f(c[0], c[1], c[2], c[3]);
         ball_draw(rend, ball_M, pend_M, bill_M, t);
@@ -53,6 +53,33 @@ static void game_draw_balls(struct s_rend *rend,
     glPopMatrix();
 }
 
+static void game_draw_balls(struct s_rend *rend,
+                            const struct s_vary *vary,
+                            const float *bill_M, float t)
+{
+    static const float c[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    game_draw_ball(rend, &vary->uv[0], c, bill_M, t);
+}
+
+static void game_draw_ghost(struct s_rend *rend,
+                            const struct game_draw *gd,
+                            const float *bill_M, float t)
+{
+    static const float c[4] = { 1.0f, 1.0f, 1.0f, 0.4f };
+
+    /* Draw the ghost see-through and without hiding anything behind it. */
+
+    if (gd->ghost_e)
+    {
+        glDepthMask(GL_FALSE);
+        game_draw_ball(rend, &gd->ghost, c, bill_M, t);
+        glDepthMask(GL_TRUE);
+
+        glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    }
+}
+
 static void game_draw_items(struct s_rend *rend,
                             const struct s_vary *vary,
                             const float *bill_M, float t)
@@ -324,9 +351,10 @@ static void game_draw_fore(struct s_rend *rend,
 
             sol_draw(draw, rend, 0, 1);
 
-            /* Draw the ball. */
+            /* Draw the ball and the ghost. */
 
             game_draw_balls(rend, draw->vary, M, t);
+            game_draw_ghost(rend, gd, M, t);
 
             break;
         }
@@ -412,6 +440,8 @@ void game_draw(struct game_draw *gd, int pose, float t)
         const struct game_view *view = &gd->view;
         struct s_rend rend;
 
+        PROF_BEGIN("game_draw");
+
         gd->draw.shadow_ui = 0;
 
         game_shadow_conf(pose, 1);
@@ -517,6 +547,8 @@ void game_draw(struct game_draw *gd, int pose, float t)
 
         r_draw_disable(&rend);
         game_shadow_conf(pose, 0);
+
+        PROF_END();
     }
 }
 
@@ -27,6 +27,9 @@ struct game_draw
 
     float fade_k;                       /* Fade in/out level                 */
     float fade_d;                       /* Fade in/out direction             */
+
+    int           ghost_e;              /* Ghost ball enabled flag           */
+    struct v_ball ghost;                /* Ghost ball                        */
 };
 
 /* FIXME: this is just for POSE_* constants. */
@@ -14,6 +14,8 @@
 
 #include <SDL.h>
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "vec3.h"
@@ -21,9 +23,12 @@
 #include "config.h"
 #include "binary.h"
 #include "common.h"
+#include "log.h"
+#include "prof.h"
 
 #include "solid_sim.h"
 #include "solid_all.h"
+#include "loadtime.h"
 
 #include "game_common.h"
 #include "game_server.h"
@@ -433,7 +438,12 @@ static void grow_step(float dt)
 
 static struct lockstep server_step;
 
-int game_server_init(const char *file_name, int t, int e)
+static void hist_init(void);
+static void hist_free(void);
+static void hist_push(void);
+static void hist_stat(float);
+
+static int server_init(const char *file_name, int t, int e)
 {
     struct { int x, y; } version;
     int i;
@@ -450,12 +460,17 @@ int game_server_init(const char *file_name, int t, int e)
     if (!game_base_load(file_name))
         return (server_state = 0);
 
+    loadtime_enter("sol_load_vary");
+
     if (!sol_load_vary(&vary, &game_base))
     {
+        loadtime_leave();
         game_base_free(NULL);
         return (server_state = 0);
     }
 
+    loadtime_leave();
+
     server_state = 1;
 
     /* Get SOL version. */
@@ -520,13 +535,30 @@ int game_server_init(const char *file_name, int t, int e)
 
     lockstep_clr(&server_step);
 
+    /* Start recording rewind history. */
+
+    hist_init();
+
     return server_state;
 }
 
+int game_server_init(const char *file_name, int t, int e)
+{
+    int rc;
+
+    loadtime_enter("game_server_init");
+    rc = server_init(file_name, t, e);
+    loadtime_leave();
+
+    return rc;
+}
+
 void game_server_free(const char *next)
 {
     if (server_state)
     {
+        hist_free();
+
         sol_quit_sim();
         sol_free_vary(&vary);
 
@@ -847,17 +879,24 @@ static void game_server_iter(float dt)
     case GAME_NONE:
         if ((status = game_step(GRAVITY_DN, dt, 1)) != GAME_NONE)
             game_cmd_status();
+        else
+            hist_push();
         break;
     }
 
     game_cmd_eou();
 }
 
-static struct lockstep server_step = { game_server_iter, DT };
+static struct lockstep server_step = { game_server_iter, DT, "server" };
 
 void game_server_step(float dt)
 {
+    PROF_BEGIN("game_server_step");
+
     lockstep_run(&server_step, dt);
+    hist_stat(dt);
+
+    PROF_END();
 }
 
 float game_server_blend(void)
@@ -867,6 +906,195 @@ float game_server_blend(void)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Rewind history. Each step of play records an undo record of the varying
+ * state and of the server state below, in a ring sized for the configured
+ * number of seconds. Holding the rewind key pops records and resyncs the
+ * client through the usual commands. Rewind is a practice aid: history is
+ * only kept with cheats enabled, and a rewound run is not scored.
+ */
+
+#define HIST_WORDS 48                   /* Ring words budgeted per step      */
+
+struct hist_ext
+{
+    float timer;
+    int   coins;
+
+    int   jump_e;
+    int   jump_b;
+    float jump_dt;
+    float jump_p[3];
+
+    int   grow;
+    int   grow_state;
+    float grow_goal;
+    float grow_t;
+    float grow_strt;
+
+    struct game_tilt tilt;
+    struct game_view view;
+
+    float view_k;
+    float view_time;
+    float view_fade;
+};
+
+static struct s_hist hist;
+static float         hist_at;           /* Rewind time accumulator           */
+static float         hist_st;           /* Time since last report            */
+static int           hist_used;         /* Rewound since the level started   */
+
+static void hist_get(struct hist_ext *x)
+{
+    memset(x, 0, sizeof (*x));
+
+    x->timer      = timer;
+    x->coins      = coins;
+    x->jump_e     = jump_e;
+    x->jump_b     = jump_b;
+    x->jump_dt    = jump_dt;
+    v_cpy(x->jump_p, jump_p);
+    x->grow       = grow;
+    x->grow_state = grow_state;
+    x->grow_goal  = grow_goal;
+    x->grow_t     = grow_t;
+    x->grow_strt  = grow_strt;
+    x->tilt       = tilt;
+    x->view       = view;
+    x->view_k     = view_k;
+    x->view_time  = view_time;
+    x->view_fade  = view_fade;
+}
+
+static void hist_set(const struct hist_ext *x)
+{
+    timer      = x->timer;
+    coins      = x->coins;
+    jump_e     = x->jump_e;
+    jump_b     = x->jump_b;
+    jump_dt    = x->jump_dt;
+    v_cpy(jump_p, x->jump_p);
+    grow       = x->grow;
+    grow_state = x->grow_state;
+    grow_goal  = x->grow_goal;
+    grow_t     = x->grow_t;
+    grow_strt  = x->grow_strt;
+    tilt       = x->tilt;
+    view       = x->view;
+    view_k     = x->view_k;
+    view_time  = x->view_time;
+    view_fade  = x->view_fade;
+}
+
+static void hist_init(void)
+{
+    int n = config_get_d(CONFIG_REWIND);
+
+    hist_free();
+
+    hist_used = 0;
+
+    if (n > 0 && config_cheat())
+    {
+        struct hist_ext x;
+
+        hist_get(&x);
+
+        if (sol_hist_init(&hist, &vary, n * UPS * HIST_WORDS, sizeof (x)))
+        {
+            sol_hist_clear(&hist, &vary, &x);
+
+            log_printf("Rewind history: %d s in %d KB\n", n,
+                       (int) (hist.size * sizeof (*hist.ring)) / 1024);
+        }
+    }
+}
+
+static void hist_free(void)
+{
+    sol_hist_free(&hist);
+
+    hist_at = 0.0f;
+    hist_st = 0.0f;
+}
+
+static void hist_push(void)
+{
+    if (hist.ring)
+    {
+        struct hist_ext x;
+
+        hist_get(&x);
+        sol_hist_push(&hist, &vary, &x);
+    }
+}
+
+static void hist_stat(float dt)
+{
+    /* Report history use once a second. */
+
+    if (hist.ring && (hist_st += dt) >= 1.0f)
+    {
+        if (config_get_d(CONFIG_STATS))
+            fprintf(stdout, "%-8s %5d %5.1f %7d\n", "rewind",
+                    (int) (hist.bytes / hist_st), hist.count * server_step.dt,
+                    (int) (hist.size * sizeof (*hist.ring)));
+
+        hist.bytes = 0;
+        hist_st    = 0.0f;
+    }
+}
+
+/*
+ * Undo up to the given amount of play. Return 1 if any was undone.
+ */
+int game_server_rewind(float dt)
+{
+    struct hist_ext x;
+    int n = 0, e, b;
+
+    if (!server_state || !hist.ring || status != GAME_NONE)
+        return 0;
+
+    hist_get(&x);
+
+    e = x.jump_e;
+    b = x.jump_b;
+
+    for (hist_at += dt; hist_at >= server_step.dt; hist_at -= server_step.dt)
+        if (sol_hist_pop(&hist, &vary, &x, game_proxy_enq))
+            n++;
+
+    if (n)
+    {
+        hist_set(&x);
+
+        hist_used = 1;
+
+        /* Bring the client up to date. */
+
+        if (e != jump_e || b != jump_b)
+            game_cmd_jump(jump_b ? 1 : 0);
+
+        game_cmd_init_balls();
+        game_cmd_timer();
+        game_cmd_coins();
+        game_cmd_tiltaxes();
+        game_cmd_tiltangles();
+        game_cmd_updview();
+        game_cmd_eou();
+    }
+    return (n > 0);
+}
+
+int game_server_rewound(void)
+{
+    return hist_used;
+}
+
+/*---------------------------------------------------------------------------*/
+
 void game_set_goal(void)
 {
     audio_play(AUD_SWITCH, 1.0f);
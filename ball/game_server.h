@@ -12,6 +12,8 @@
 int   game_server_init(const char *, int, int);
 void  game_server_free(const char *);
 void  game_server_step(float);
+int   game_server_rewind(float);
+int   game_server_rewound(void);
 float game_server_blend(void);
 
 void  game_set_goal(void);
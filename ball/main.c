@@ -26,6 +26,7 @@
 #include "audio.h"
 #include "demo.h"
 #include "progress.h"
+#include "game_common.h"
 #include "gui.h"
 #include "set.h"
 #include "tilt.h"
@@ -35,12 +36,22 @@
 #include "text.h"
 #include "mtrl.h"
 #include "geom.h"
+#include "prof.h"
+#include "frame.h"
+#include "loadtime.h"
 
 #include "st_conf.h"
 #include "st_title.h"
 #include "st_demo.h"
 #include "st_level.h"
 #include "st_pause.h"
+#include "st_play.h"
+#include "st_goal.h"
+#include "st_fail.h"
+#include "st_done.h"
+#include "st_over.h"
+#include "st_start.h"
+#include "st_set.h"
 
 const char TITLE[] = "Neverball " VERSION;
 const char ICON[] = "icon/neverball.png";
@@ -76,6 +87,36 @@ static void toggle_wire(void)
 
 /*---------------------------------------------------------------------------*/
 
+#define STATE(s) { &s, #s }
+
+/*
+ * Name the states that frame time statistics are broken down by.
+ */
+static void name_states(void)
+{
+    static const struct
+    {
+        struct state *st;
+        const char   *name;
+    } names[] = {
+        STATE(st_title),      STATE(st_set),        STATE(st_start),
+        STATE(st_level),      STATE(st_play_ready), STATE(st_play_set),
+        STATE(st_play_loop),  STATE(st_look),       STATE(st_pause),
+        STATE(st_goal),       STATE(st_fail),       STATE(st_done),
+        STATE(st_over),       STATE(st_demo),       STATE(st_demo_play),
+        STATE(st_demo_end),   STATE(st_conf)
+    };
+
+    int i;
+
+    for (i = 0; i < ARRAYSIZE(names); i++)
+        frame_name(names[i].st, names[i].name);
+}
+
+#undef STATE
+
+/*---------------------------------------------------------------------------*/
+
 static int handle_key_dn(SDL_Event *e)
 {
     int d = 1;
@@ -99,6 +140,9 @@ static int handle_key_dn(SDL_Event *e)
     case KEY_FPS:
         config_tgl_d(CONFIG_FPS);
         break;
+    case KEY_PROFILE:
+        PROF_DUMP();
+        break;
     case KEY_WIREFRAME:
         if (config_cheat())
             toggle_wire();
@@ -547,7 +591,7 @@ static void make_dirs_and_migrate(void)
 int main(int argc, char *argv[])
 {
     SDL_Joystick *joy = NULL;
-    int t1, t0;
+    int t1, t0, pending;
 
     if (!fs_init(argv[0]))
     {
@@ -600,10 +644,13 @@ int main(int argc, char *argv[])
 
     /* Material system. */
 
+    image_init();
     mtrl_init();
+    game_base_init();
 
     /* Screen states. */
 
+    name_states();
     init_state(&st_null);
 
     /* Initialize demo playback or load the level. */
@@ -658,20 +705,34 @@ int main(int argc, char *argv[])
 
             t0 = t1;
 
+            /* Upload any images decoded in the background. */
+
+            pending = image_sync(0);
+
             /* Render. */
 
             hmd_step();
             st_paint(0.001f * t0);
             video_swap();
 
+            loadtime_frame(pending);
+
             if (config_get_d(CONFIG_NICE))
                 SDL_Delay(1);
         }
     }
 
+    PROF_DUMP();
+
+    frame_save("frames.csv");
     config_save();
 
+    log_printf("File lookups saved by the cache: %d\n", fs_cache_saved());
+    config_quit();
+
+    game_base_quit();
     mtrl_quit();
+    image_quit();
 
     if (joy)
         SDL_JoystickClose(joy);
@@ -20,6 +20,7 @@
 #include "lang.h"
 #include "score.h"
 #include "audio.h"
+#include "loadtime.h"
 
 #include "game_common.h"
 #include "game_client.h"
@@ -53,6 +54,8 @@ static struct progress prev;
 static int score_rank = RANK_LAST;
 static int times_rank = RANK_LAST;
 
+static int rewound = 0; /* Some level of the run was rewound. */
+
 /* Level stats. */
 
 static int status = GAME_NONE;
@@ -87,11 +90,15 @@ void progress_init(int m)
     score_rank = RANK_LAST;
     times_rank = RANK_LAST;
 
+    rewound = 0;
+
     done  = 0;
 }
 
-static int init_level(void)
+static int init_level(int same)
 {
+    loadtime_begin(level_file(level));
+
     demo_play_init(USER_REPLAY_FILE, level, mode,
                    curr.score, curr.balls, curr.times);
 
@@ -101,14 +108,26 @@ static int init_level(void)
      * server.
      */
 
-    if (game_client_init(level_file(level)) &&
+    /*
+     * A restart of the level on screen keeps its draw data and only
+     * resets the client's varying state.
+     */
+
+    if (((same && game_client_reset(level_file(level))) ||
+         game_client_init(level_file(level))) &&
         game_server_init(level_file(level), level_time(level), goal_e))
     {
-        game_client_sync(demo_fp);
+        game_client_sync(demo_play_cmd);
+
+        loadtime_enter("audio_music_fade_to");
         audio_music_fade_to(2.0f, level_song(level));
+        loadtime_leave();
+
+        demo_ghost_init(config_get_s(CONFIG_GHOST), level_file(level));
         return 1;
     }
 
+    loadtime_end();
     demo_play_stop(1);
     return 0;
 }
@@ -117,6 +136,8 @@ int  progress_play(struct level *l)
 {
     if (l && (level_opened(l) || config_cheat()))
     {
+        int same = same_goal_e && l == level;
+
         level = l;
 
         next   = NULL;
@@ -137,7 +158,7 @@ int  progress_play(struct level *l)
         goal_rank = RANK_LAST;
         coin_rank = RANK_LAST;
 
-        return init_level();
+        return init_level(same);
     }
     return 0;
 }
@@ -164,6 +185,9 @@ void progress_stat(int s)
 
     status = s;
 
+    if (!replay && game_server_rewound())
+        rewound = 1;
+
     coins = curr_coins();
     timer = (level_time(level) == 0 ?
              curr_clock() :
@@ -180,10 +204,15 @@ void progress_stat(int s)
         curr.score += coins;
         curr.times += timer;
 
-        dirty = level_score_update(level, timer, coins,
-                                   &time_rank,
-                                   goal == 0 ? &goal_rank : NULL,
-                                   &coin_rank);
+        /* A rewound level is completed but not scored. */
+
+        if (!replay && game_server_rewound())
+            time_rank = goal_rank = coin_rank = RANK_LAST;
+        else
+            dirty = level_score_update(level, timer, coins,
+                                       &time_rank,
+                                       goal == 0 ? &goal_rank : NULL,
+                                       &coin_rank);
 
         if (!level_completed(level))
         {
@@ -257,13 +286,14 @@ void progress_stop(void)
         d = 0;
 
     demo_play_stop(d);
+    demo_ghost_stop();
 }
 
 void progress_exit(void)
 {
     assert(done);
 
-    if (set_score_update(curr.times, curr.score, &score_rank, &times_rank))
+    if (!rewound && set_score_update(curr.times, curr.score, &score_rank, &times_rank))
         set_store_hs();
 }
 
@@ -329,6 +359,17 @@ int  progress_same(void)
     return progress_play(level);
 }
 
+/*
+ * Start loading the levels the player may pick next.
+ */
+void progress_prefetch(void)
+{
+    if (progress_next_avail())
+        game_base_prefetch(level_file(next));
+    if (progress_same_avail())
+        game_base_prefetch(level_file(level));
+}
+
 int  progress_dead(void)
 {
     return mode == MODE_CHALLENGE ? curr.balls < 0 : 0;
@@ -17,6 +17,7 @@ int  progress_next_avail(void);
 int  progress_next(void);
 int  progress_same_avail(void);
 int  progress_same(void);
+void progress_prefetch(void);
 
 void progress_rename(int);
 
@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Decode every replay in a directory and write one CSV row per replay:
+ * its header, simulated duration, size, bytes per second of play, the
+ * highest ball speed and a count of each command type. Replays are
+ * decoded on a pool of threads; rows are written in file name order,
+ * and no more than WINDOW replays are in flight at any one time. Run as
+ *
+ *     replaystat <dir> [threads] > replays.csv
+ *
+ * Replays that cannot be read are listed with valid set to 0.
+ */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "demo.h"
+#include "game_common.h"
+#include "cmd.h"
+#include "vec3.h"
+#include "fs.h"
+#include "common.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define WORKER_MAX 16
+#define WINDOW     64                   /* Replays decoded ahead of output   */
+
+/* Column names, in the order of enum cmd_type. */
+
+static const char *cmd_names[CMD_MAX] = {
+    "unknown",
+    "end_of_update",
+    "make_ball",
+    "make_item",
+    "pick_item",
+    "tilt_angles",
+    "sound",
+    "timer",
+    "status",
+    "coins",
+    "jump_enter",
+    "jump_exit",
+    "body_path",
+    "body_time",
+    "goal_open",
+    "swch_enter",
+    "swch_toggle",
+    "swch_exit",
+    "updates_per_second",
+    "ball_radius",
+    "clear_items",
+    "clear_balls",
+    "ball_position",
+    "ball_basis",
+    "ball_pend_basis",
+    "view_position",
+    "view_center",
+    "view_basis",
+    "current_ball",
+    "path_flag",
+    "step_simulation",
+    "map",
+    "tilt_axes",
+    "move_path",
+    "move_time"
+};
+
+static const char *status_names[GAME_MAX] = {
+    "none",
+    "time",
+    "goal",
+    "fall"
+};
+
+struct row
+{
+    char        path[PATHMAX];
+    int         done;
+
+    int         valid;
+    struct demo d;
+
+    int         bytes;
+    float       duration;               /* Simulated time, in seconds        */
+    float       max_speed;              /* Ball speed, in units per second   */
+    int         counts[CMD_MAX];
+};
+
+static Array       items;
+static struct row  rows[WINDOW];
+
+static SDL_mutex  *mutex;
+static SDL_cond   *cond;
+static int         next_job;
+static int         printed;
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Read a replay from start to end. Ball speed is measured between
+ * successive positions of the same ball, and not across jumps or new
+ * balls.
+ */
+static void decode(struct row *r)
+{
+    union cmd cmd;
+    fs_file fp;
+
+    float p[3], t = 0.0f;
+    int have_p = 0;
+
+    if ((fp = fs_open(r->path, "r")))
+    {
+        r->bytes = fs_length(fp);
+
+        /* The header date goes through localtime, which is not reentrant. */
+
+        SDL_LockMutex(mutex);
+        r->valid = demo_header_read(fp, &r->d);
+        SDL_UnlockMutex(mutex);
+
+        if (r->valid)
+        {
+            while (cmd_get(fp, &cmd))
+            {
+                r->counts[cmd.type]++;
+
+                switch (cmd.type)
+                {
+                case CMD_STEP_SIMULATION:
+                    r->duration += cmd.stepsim.dt;
+                    break;
+
+                case CMD_BALL_POSITION:
+                    if (have_p && r->duration > t)
+                    {
+                        float d[3], v;
+
+                        v_sub(d, cmd.ballpos.p, p);
+
+                        v = v_len(d) / (r->duration - t);
+
+                        if (v > r->max_speed)
+                            r->max_speed = v;
+                    }
+                    v_cpy(p, cmd.ballpos.p);
+                    t = r->duration;
+                    have_p = 1;
+                    break;
+
+                case CMD_MAKE_BALL:
+                case CMD_CLEAR_BALLS:
+                case CMD_CURRENT_BALL:
+                case CMD_JUMP_EXIT:
+                    have_p = 0;
+                    break;
+
+                /* Release strings, as cmd_free would for a heap command. */
+
+                case CMD_SOUND:
+                    free(cmd.sound.n);
+                    break;
+
+                case CMD_MAP:
+                    free(cmd.map.name);
+                    break;
+
+                default:
+                    break;
+                }
+            }
+        }
+        fs_close(fp);
+    }
+}
+
+static int worker_func(void *data)
+{
+    struct row *r;
+    int i;
+
+    SDL_LockMutex(mutex);
+
+    while (next_job < array_len(items))
+    {
+        /* Wait for the slot of this job to be written out. */
+
+        if (next_job >= printed + WINDOW)
+        {
+            SDL_CondWait(cond, mutex);
+            continue;
+        }
+
+        i = next_job++;
+        r = &rows[i % WINDOW];
+
+        /* The writer reads done under the lock, so reset the slot here. */
+
+        memset(r, 0, sizeof (*r));
+        SAFECPY(r->path, DIR_ITEM_GET(items, i)->path);
+
+        SDL_UnlockMutex(mutex);
+        {
+            decode(r);
+        }
+        SDL_LockMutex(mutex);
+
+        r->done = 1;
+        SDL_CondBroadcast(cond);
+    }
+
+    SDL_UnlockMutex(mutex);
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void put_csv_string(const char *s)
+{
+    putchar('"');
+
+    for (; *s; s++)
+    {
+        if (*s == '"')
+            putchar('"');
+        putchar(*s);
+    }
+
+    putchar('"');
+}
+
+static void put_head(void)
+{
+    int i;
+
+    printf("replay,valid,player,level,mode,status,timer_s,coins,"
+           "duration_s,bytes,bytes_per_s,max_speed");
+
+    for (i = 0; i < CMD_MAX; i++)
+        printf(",%s", cmd_names[i]);
+
+    printf("\n");
+}
+
+static void put_row(const struct row *r)
+{
+    const struct demo *d = &r->d;
+    int i;
+
+    put_csv_string(r->path);
+    printf(",%d,", r->valid);
+    put_csv_string(d->player);
+    putchar(',');
+    put_csv_string(d->file);
+
+    printf(",%d,%s,%.2f,%d,%.3f,%d,%.1f,%.3f",
+           d->mode,
+           (d->status >= 0 && d->status < GAME_MAX) ?
+           status_names[d->status] : "?",
+           d->timer / 100.0f,
+           d->coins,
+           r->duration,
+           r->bytes,
+           r->duration > 0.0f ? r->bytes / r->duration : 0.0f,
+           r->max_speed);
+
+    for (i = 0; i < CMD_MAX; i++)
+        printf(",%d", r->counts[i]);
+
+    printf("\n");
+}
+
+static int is_replay(struct dir_item *item)
+{
+    return str_ends_with(item->path, ".nbr");
+}
+
+static int cmp_items(const void *A, const void *B)
+{
+    const struct dir_item *a = A, *b = B;
+    return strcmp(a->path, b->path);
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    SDL_Thread *threads[WORKER_MAX];
+    int i, n = 0, count, ret = 1;
+
+    if (!fs_init(argv[0]))
+    {
+        fprintf(stderr, "Failure to initialize virtual file system: %s\n",
+                fs_error());
+        return 1;
+    }
+
+    if (argc == 2 || argc == 3)
+    {
+        fs_add_path(argv[1]);
+
+        count = (argc == 3) ? atoi(argv[2]) : SDL_GetCPUCount();
+        count = CLAMP(1, count, WORKER_MAX);
+
+        if ((items = fs_dir_scan("", is_replay)))
+        {
+            array_sort(items, cmp_items);
+
+            if ((mutex = SDL_CreateMutex()) && (cond = SDL_CreateCond()))
+            {
+                for (i = 0; i < count; i++)
+                    if ((threads[n] = SDL_CreateThread(worker_func,
+                                                       "replay", NULL)))
+                        n++;
+            }
+
+            if (n > 0)
+            {
+                put_head();
+
+                /* Write rows in order as their replays finish. */
+
+                SDL_LockMutex(mutex);
+
+                while (printed < array_len(items))
+                {
+                    struct row *r = &rows[printed % WINDOW];
+
+                    if (r->done)
+                    {
+                        SDL_UnlockMutex(mutex);
+                        put_row(r);
+                        SDL_LockMutex(mutex);
+
+                        r->done = 0;
+                        printed++;
+                        SDL_CondBroadcast(cond);
+                    }
+                    else SDL_CondWait(cond, mutex);
+                }
+
+                SDL_UnlockMutex(mutex);
+
+                for (i = 0; i < n; i++)
+                    SDL_WaitThread(threads[i], NULL);
+
+                fprintf(stderr, "%d replays, %d threads\n", printed, n);
+                ret = 0;
+            }
+            else fprintf(stderr, "Failure to start threads: %s\n",
+                         SDL_GetError());
+
+            if (cond)  SDL_DestroyCond(cond);
+            if (mutex) SDL_DestroyMutex(mutex);
+
+            fs_dir_free(items);
+        }
+        else fprintf(stderr, "Failure to scan %s\n", argv[1]);
+    }
+    else fprintf(stderr, "Usage: %s <dir> [threads]\n", argv[0]);
+
+    fs_quit();
+
+    return ret;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -13,6 +13,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -47,6 +48,7 @@ struct set
 
     /* Level info                                                            */
 
+    int   loaded;                       /* Level names have been read        */
     int   count;                        /* Number of levels                  */
     char *level_name_v[MAXLVL];         /* List of level file names          */
 };
@@ -259,24 +261,261 @@ static void set_load_hs(void)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * The catalog caches the header of every set file, keyed by the
+ * directory or archive the file is found in and its modification time.
+ * With it, set_init opens no set files that have not changed. The level
+ * list of a set is only read when the set is entered.
+ */
+
+#define CATALOG_FILE    "Cache/sets.txt"
+#define CATALOG_VERSION 1
+
+#define HEAD_LINES 5                    /* Name, desc, id, shot, scores      */
+
+struct entry
+{
+    char *file;
+    char *real;
+    long  mtime;
+    char *head[HEAD_LINES];
+
+    int   seen;                         /* Still present this scan           */
+};
+
+#define ENTRY_GET(a, i) ((struct entry *) array_get((a), (i)))
+
+static Array catalog;
+static int   catalog_dirty;
+
+static void entry_free(struct entry *e)
+{
+    int i;
+
+    free(e->file);
+    free(e->real);
+
+    for (i = 0; i < HEAD_LINES; i++)
+        free(e->head[i]);
+}
+
+static int read_head(char *head[HEAD_LINES], fs_file fin)
+{
+    int i;
+
+    for (i = 0; i < HEAD_LINES; i++)
+        if (!read_line(&head[i], fin))
+        {
+            while (i--)
+                free(head[i]);
+            return 0;
+        }
+
+    return 1;
+}
+
+static void catalog_load(void)
+{
+    fs_file fp;
+
+    catalog       = array_new(sizeof (struct entry));
+    catalog_dirty = 0;
+
+    if ((fp = fs_open(CATALOG_FILE, "r")))
+    {
+        char line[MAXSTR];
+        int version = 0;
+
+        if (fs_gets(line, sizeof (line), fp) &&
+            sscanf(line, "version %d", &version) == 1 &&
+            version == CATALOG_VERSION)
+        {
+            struct entry e;
+            char *mtime;
+
+            memset(&e, 0, sizeof (e));
+
+            while (read_line(&e.file, fp))
+            {
+                if (read_line(&e.real, fp))
+                {
+                    if (read_line(&mtime, fp))
+                    {
+                        e.mtime = atol(mtime);
+                        free(mtime);
+
+                        if (read_head(e.head, fp))
+                        {
+                            memcpy(array_add(catalog), &e, sizeof (e));
+                            memset(&e, 0, sizeof (e));
+                            continue;
+                        }
+                    }
+                    free(e.real);
+                }
+                free(e.file);
+                break;
+            }
+        }
+        fs_close(fp);
+    }
+}
+
+static void catalog_save(void)
+{
+    fs_file fp;
+    int i, j;
+
+    /* Rewrite only if something changed or went away. */
+
+    for (i = 0; i < array_len(catalog); i++)
+        if (!ENTRY_GET(catalog, i)->seen)
+            catalog_dirty = 1;
+
+    if (!catalog_dirty)
+        return;
+
+    fs_mkdir("Cache");
+
+    if ((fp = fs_open(CATALOG_FILE, "w")))
+    {
+        fs_printf(fp, "version %d\n", CATALOG_VERSION);
+
+        for (i = 0; i < array_len(catalog); i++)
+        {
+            const struct entry *e = ENTRY_GET(catalog, i);
+
+            if (e->seen)
+            {
+                fs_printf(fp, "%s\n%s\n%ld\n", e->file, e->real, e->mtime);
+
+                for (j = 0; j < HEAD_LINES; j++)
+                    fs_printf(fp, "%s\n", e->head[j]);
+            }
+        }
+        fs_close(fp);
+    }
+}
+
+static void catalog_free(void)
+{
+    int i;
+
+    for (i = 0; i < array_len(catalog); i++)
+        entry_free(ENTRY_GET(catalog, i));
+
+    array_free(catalog);
+    catalog = NULL;
+}
+
+static struct entry *catalog_find(const char *file)
+{
+    int i;
+
+    for (i = 0; i < array_len(catalog); i++)
+        if (strcmp(ENTRY_GET(catalog, i)->file, file) == 0)
+            return ENTRY_GET(catalog, i);
+
+    return NULL;
+}
+
+/*
+ * Find the cached header of FILE, if the file has not changed since.
+ */
+static struct entry *catalog_get(const char *file)
+{
+    struct entry *e;
+    const char *real;
+
+    if (catalog && (e = catalog_find(file)))
+    {
+        if ((real = fs_real_dir(file)) && strcmp(e->real, real) == 0 &&
+            e->mtime == fs_mtime(file) && e->mtime != -1)
+        {
+            e->seen = 1;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void catalog_put(const char *file, char *head[HEAD_LINES])
+{
+    struct entry *e;
+    const char *real;
+    long mtime;
+    int i;
+
+    if (!catalog || !(real = fs_real_dir(file)))
+        return;
+
+    if ((mtime = fs_mtime(file)) == -1)
+        return;
+
+    if ((e = catalog_find(file)))
+        entry_free(e);
+    else
+        e = array_add(catalog);
+
+    e->file  = strdup(file);
+    e->real  = strdup(real);
+    e->mtime = mtime;
+    e->seen  = 1;
+
+    for (i = 0; i < HEAD_LINES; i++)
+        e->head[i] = strdup(head[i]);
+
+    catalog_dirty = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void set_head(struct set *s, char *head[HEAD_LINES])
+{
+    s->name = strdup(head[0]);
+    s->desc = strdup(head[1]);
+    s->id   = strdup(head[2]);
+    s->shot = strdup(head[3]);
+
+    sscanf(head[4], "%d %d %d %d %d %d",
+           &s->time_score.timer[RANK_HARD],
+           &s->time_score.timer[RANK_MEDM],
+           &s->time_score.timer[RANK_EASY],
+           &s->coin_score.coins[RANK_HARD],
+           &s->coin_score.coins[RANK_MEDM],
+           &s->coin_score.coins[RANK_EASY]);
+
+    s->user_scores  = concat_string("Scores/", s->id, ".txt",       NULL);
+    s->cheat_scores = concat_string("Scores/", s->id, "-cheat.txt", NULL);
+}
+
+static void set_read_levels(struct set *s, fs_file fin)
+{
+    char *level_name;
+
+    s->count = 0;
+
+    while (s->count < MAXLVL && read_line(&level_name, fin))
+    {
+        s->level_name_v[s->count] = level_name;
+        s->count++;
+    }
+
+    s->loaded = 1;
+}
+
 static int set_load(struct set *s, const char *filename)
 {
+    struct entry *e;
     fs_file fin;
-    char *scores, *level_name;
+    char *head[HEAD_LINES];
+    int i;
 
     /* Skip "Misc" set when not in dev mode. */
 
     if (strcmp(filename, SET_MISC) == 0 && !config_cheat())
         return 0;
 
-    fin = fs_open(filename, "r");
-
-    if (!fin)
-    {
-        log_printf("Failure to load set file %s\n", filename);
-        return 0;
-    }
-
     memset(s, 0, sizeof (struct set));
 
     /* Set some sane values in case the scores are missing. */
@@ -286,48 +525,65 @@ static int set_load(struct set *s, const char *filename)
 
     SAFECPY(s->file, filename);
 
-    if (read_line(&s->name, fin) &&
-        read_line(&s->desc, fin) &&
-        read_line(&s->id,   fin) &&
-        read_line(&s->shot, fin) &&
-        read_line(&scores,  fin))
+    if ((e = catalog_get(filename)))
     {
-        sscanf(scores, "%d %d %d %d %d %d",
-               &s->time_score.timer[RANK_HARD],
-               &s->time_score.timer[RANK_MEDM],
-               &s->time_score.timer[RANK_EASY],
-               &s->coin_score.coins[RANK_HARD],
-               &s->coin_score.coins[RANK_MEDM],
-               &s->coin_score.coins[RANK_EASY]);
+        set_head(s, e->head);
+        return 1;
+    }
+
+    fin = fs_open(filename, "r");
 
-        free(scores);
+    if (!fin)
+    {
+        log_printf("Failure to load set file %s\n", filename);
+        return 0;
+    }
 
-        s->user_scores  = concat_string("Scores/", s->id, ".txt",       NULL);
-        s->cheat_scores = concat_string("Scores/", s->id, "-cheat.txt", NULL);
+    if (read_head(head, fin))
+    {
+        set_head(s, head);
+        catalog_put(filename, head);
 
-        s->count = 0;
+        for (i = 0; i < HEAD_LINES; i++)
+            free(head[i]);
 
-        while (s->count < MAXLVL && read_line(&level_name, fin))
-        {
-            s->level_name_v[s->count] = level_name;
-            s->count++;
-        }
+        set_read_levels(s, fin);
 
         fs_close(fin);
 
         return 1;
     }
 
-    free(s->name);
-    free(s->desc);
-    free(s->id);
-    free(s->shot);
-
     fs_close(fin);
 
     return 0;
 }
 
+/*
+ * Read the level list of a set whose header came from the catalog.
+ */
+static void set_load_names(struct set *s)
+{
+    fs_file fin;
+    char *head[HEAD_LINES];
+    int i;
+
+    s->loaded = 1;
+
+    if ((fin = fs_open(s->file, "r")))
+    {
+        if (read_head(head, fin))
+        {
+            for (i = 0; i < HEAD_LINES; i++)
+                free(head[i]);
+
+            set_read_levels(s, fin);
+        }
+        fs_close(fin);
+    }
+    else log_printf("Failure to load set file %s\n", s->file);
+}
+
 static void set_free(struct set *s)
 {
     int i;
@@ -384,6 +640,8 @@ int set_init()
     sets = array_new(sizeof (struct set));
     curr = 0;
 
+    catalog_load();
+
     /*
      * First, load the sets listed in the set file, preserving order.
      */
@@ -422,6 +680,9 @@ int set_init()
         fs_dir_free(items);
     }
 
+    catalog_save();
+    catalog_free();
+
     return array_len(sets);
 }
 
@@ -490,6 +751,9 @@ static void set_load_levels(void)
     int regular = 1, bonus = 1;
     int i;
 
+    if (!s->loaded)
+        set_load_names(s);
+
     for (i = 0; i < s->count; i++)
     {
         struct level *l = &level_v[i];
@@ -126,7 +126,7 @@ static int gui_demo_thumbs(int id)
                         {
                             gui_space(ld);
 
-                            thumb->shot = gui_image(ld, " ", iw, ih);
+                            thumb->shot = gui_thumb(ld, "", iw, ih);
                             thumb->name = gui_label(ld, " ", GUI_SML, gui_wht, gui_wht);
 
                             gui_set_trunc(thumb->name, TRUNC_TAIL);
@@ -157,7 +157,7 @@ static void gui_demo_update_thumbs(void)
         item = DIR_ITEM_GET(items, thumbs[i].item);
         demo = item->data;
 
-        gui_set_image(thumbs[i].shot, demo ? demo->shot : "");
+        gui_set_thumb(thumbs[i].shot, demo ? demo->shot : "");
         gui_set_label(thumbs[i].name, demo ? demo->name : base_name(item->path));
     }
 }
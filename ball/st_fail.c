@@ -145,7 +145,7 @@ static void fail_timer(int id, float dt)
         if (!resume && time_state() < 2.f)
         {
             game_server_step(dt);
-            game_client_sync(demo_fp);
+            game_client_sync(demo_play_cmd);
             game_client_blend(game_server_blend());
         }
     }
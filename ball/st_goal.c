@@ -247,6 +247,7 @@ static int goal_enter(struct state *st, struct state *prev)
     audio_music_fade_out(2.0f);
     video_clr_grab();
     resume = (prev == &st_goal || prev == &st_name || prev == &st_save);
+    progress_prefetch();
     return goal_gui();
 }
 
@@ -261,7 +262,7 @@ static void goal_timer(int id, float dt)
         if (time_state() < 1.f)
         {
             game_server_step(dt);
-            game_client_sync(demo_fp);
+            game_client_sync(demo_play_cmd);
             game_client_blend(game_server_blend());
         }
         else if (t > 0.05f && coins_id)
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "video.h"
 #include "cmd.h"
+#include "solid_vary.h"
 
 #include "game_common.h"
 #include "game_server.h"
@@ -320,6 +321,7 @@ static int rot_get(float *v)
 
 static int fast_rotate;
 static int show_hud;
+static int rewinding;
 
 static int play_loop_gui(void)
 {
@@ -338,6 +340,7 @@ static int play_loop_enter(struct state *st, struct state *prev)
 {
     rot_init();
     fast_rotate = 0;
+    rewinding   = 0;
 
     if (prev == &st_pause)
         return 0;
@@ -354,6 +357,11 @@ static int play_loop_enter(struct state *st, struct state *prev)
 
 static void play_loop_paint(int id, float t)
 {
+    struct v_ball ghost;
+
+    if (demo_ghost_ball(&ghost))
+        game_client_ghost(&ghost);
+
     game_client_draw(0, t);
 
     if (show_hud)
@@ -395,8 +403,12 @@ static void play_loop_timer(int id, float dt)
 
     game_step_fade(dt);
 
-    game_server_step(dt);
-    game_client_sync(demo_fp);
+    if (!rewinding || !game_server_rewind(dt))
+        game_server_step(dt);
+
+    demo_ghost_step(dt);
+
+    game_client_sync(demo_play_cmd);
     game_client_blend(game_server_blend());
 
     switch (curr_status())
@@ -500,6 +512,8 @@ static int play_loop_keybd(int c, int d)
             rot_set(DIR_L, 1.0f, 0);
         if (config_tst_d(CONFIG_KEY_ROTATE_FAST, c))
             fast_rotate = 1;
+        if (config_tst_d(CONFIG_KEY_REWIND, c))
+            rewinding = 1;
 
         keybd_camera(c);
 
@@ -520,6 +534,8 @@ static int play_loop_keybd(int c, int d)
             rot_clr(DIR_L);
         if (config_tst_d(CONFIG_KEY_ROTATE_FAST, c))
             fast_rotate = 0;
+        if (config_tst_d(CONFIG_KEY_REWIND, c))
+            rewinding = 0;
     }
 
     if (d && c == KEY_LOOKAROUND && config_cheat())
@@ -125,7 +125,7 @@ static int set_gui(void)
                     for (j = i + row - 1; j >= i; --j) {
                         if (set_exists(j) && (kd = gui_vstack(jd))) {
                             gui_space(kd);
-                            gui_image(kd, set_shot(j), iw, ih);
+                            gui_thumb(kd, set_shot(j), iw, ih);
                             gui_label(kd, set_name(j), GUI_SML, gui_wht, gui_wht);
                             gui_set_state(kd, SET_SELECT, j);
                         }
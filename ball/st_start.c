@@ -74,7 +74,7 @@ static void gui_level(int id, int i, int w, int h)
 
     if ((jd = gui_vstack(id))) {
         gui_space(jd);
-        gui_image(jd, level_shot(l), w, h);
+        gui_thumb(jd, level_shot(l), w, h);
         gui_label(jd, level_name(l), GUI_SML, back, fore);
         if (level_opened(l) || config_cheat())
             gui_set_state(jd, START_LEVEL, i);
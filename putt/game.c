@@ -13,6 +13,7 @@
  */
 
 #include <SDL.h>
+#include <SDL_thread.h>
 #include <math.h>
 
 #include "glext.h"
@@ -86,6 +87,270 @@ static void view_init(void)
     view_e[2][2] = 1.f;
 }
 
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Shot preview. While aiming, a copy of the sim is run forward on a worker
+ * thread and the ball position is sampled along the way. A change of aim
+ * cancels the run in progress and queues a new one. The worker gets its
+ * own copy of the sim state once per hole; each request after that is
+ * a snapshot of the live state, restored into the copy.
+ */
+
+#define PATH_LEN  64                    /* Samples per path                  */
+#define PATH_STEP 5                     /* Frames per sample                 */
+
+static SDL_Thread *path_thread;
+static SDL_mutex  *path_mutex;
+static SDL_cond   *path_cond;
+static int         path_stop;
+static int         path_busy;
+
+static struct s_vary      path_vary;    /* Worker copy of the sim state      */
+static struct s_vary_snap path_req;     /* Sim state of the latest request   */
+static int                path_ready;
+
+static SDL_atomic_t  path_want;         /* Generation of the latest request  */
+static int           path_ball;
+static float         path_aim[3];
+
+static float path_p[PATH_LEN][3];       /* Sampled path                      */
+static int   path_n;
+static int   path_done;                 /* Generation of the sampled path    */
+
+static int path_run(struct s_vary *fp, int ui, int gen, float p[][3])
+{
+    const float g[3] = { 0.0f, -9.8f, 0.0f };
+
+    const struct v_ball *up = fp->uv + ui;
+    const float y = up->p[1];
+
+    int i, j, m;
+
+    for (i = 0; i < PATH_LEN; i++)
+    {
+        v_cpy(p[i], up->p);
+
+        /* Stop once the ball rests, falls away, or the aim moves on. */
+
+        if (v_len(up->v) == 0.0f || up->p[1] < y - 10.0f)
+            return i + 1;
+
+        if (SDL_AtomicGet(&path_want) != gen)
+            return 0;
+
+        /* Step frames of MAX_DT, each a single step as in game_step. */
+
+        for (j = 0; j < PATH_STEP; j++)
+        {
+            m = 0;
+            sol_step(fp, NULL, g, MAX_DT, ui, &m);
+        }
+    }
+    return PATH_LEN;
+}
+
+static int path_func(void *data)
+{
+    float v[3], p[PATH_LEN][3];
+    int gen, ui, n;
+
+    SDL_LockMutex(path_mutex);
+
+    while (!path_stop)
+    {
+        if (!path_ready)
+        {
+            SDL_CondWait(path_cond, path_mutex);
+            continue;
+        }
+
+        /* Take the latest request. */
+
+        sol_vary_restore(&path_vary, &path_req);
+
+        ui  = path_ball;
+        gen = SDL_AtomicGet(&path_want);
+
+        v_cpy(v, path_aim);
+        v_cpy(path_vary.uv[ui].v, v);
+
+        path_ready = 0;
+        path_busy  = 1;
+        SDL_UnlockMutex(path_mutex);
+
+        n = path_run(&path_vary, ui, gen, p);
+
+        SDL_LockMutex(path_mutex);
+        path_busy = 0;
+
+        if (n && gen == SDL_AtomicGet(&path_want))
+        {
+            memcpy(path_p, p, n * sizeof (p[0]));
+            path_n    = n;
+            path_done = gen;
+        }
+
+        SDL_CondBroadcast(path_cond);
+    }
+
+    SDL_UnlockMutex(path_mutex);
+
+    return 0;
+}
+
+static void path_init(void)
+{
+    if (!sol_copy_vary(&path_vary, &file.vary))
+        return;
+
+    if (sol_vary_snap_init(&path_req, &file.vary))
+    {
+        if ((path_mutex = SDL_CreateMutex()))
+        {
+            if ((path_cond = SDL_CreateCond()))
+            {
+                path_stop  = 0;
+                path_ready = 0;
+
+                if ((path_thread = SDL_CreateThread(path_func, "preview",
+                                                    NULL)))
+                    return;
+
+                SDL_DestroyCond(path_cond);
+                path_cond = NULL;
+            }
+            SDL_DestroyMutex(path_mutex);
+            path_mutex = NULL;
+        }
+        sol_vary_snap_free(&path_req);
+    }
+    sol_free_vary(&path_vary);
+}
+
+static void path_free(void)
+{
+    if (path_thread)
+    {
+        SDL_LockMutex(path_mutex);
+        {
+            path_stop = 1;
+            SDL_AtomicAdd(&path_want, 1);
+            SDL_CondBroadcast(path_cond);
+        }
+        SDL_UnlockMutex(path_mutex);
+
+        SDL_WaitThread(path_thread, NULL);
+
+        SDL_DestroyCond (path_cond);
+        SDL_DestroyMutex(path_mutex);
+
+        path_thread = NULL;
+        path_cond   = NULL;
+        path_mutex  = NULL;
+
+        sol_vary_snap_free(&path_req);
+        sol_free_vary(&path_vary);
+    }
+
+    path_n = 0;
+}
+
+/*
+ * Compute the initial velocity of a putt at the current aim.
+ */
+static void game_putt_v(float v[3])
+{
+    /*
+     * HACK: The BALL_FUDGE here  guarantees that a putt doesn't drive
+     * the ball  too directly down  toward a lump,  triggering rolling
+     * friction too early and stopping the ball prematurely.
+     */
+
+    v[0] = -4.f * view_e[2][0] * view_m;
+    v[1] = -4.f * view_e[2][1] * view_m + BALL_FUDGE;
+    v[2] = -4.f * view_e[2][2] * view_m;
+}
+
+/*
+ * Queue a preview of the putt at the current aim, if it has changed.
+ */
+void game_aim(void)
+{
+    float v[3];
+
+    if (!state || !config_get_d(CONFIG_PREVIEW))
+        return;
+
+    if (!path_thread)
+        path_init();
+    if (!path_thread)
+        return;
+
+    game_putt_v(v);
+
+    if (v[0] == path_aim[0] &&
+        v[1] == path_aim[1] &&
+        v[2] == path_aim[2] && path_n)
+        return;
+
+    SDL_LockMutex(path_mutex);
+    {
+        /* Copy the live state into the snapshot arena, no allocation. */
+
+        if (sol_vary_snapshot(&path_req, &file.vary))
+        {
+            v_cpy(path_aim, v);
+            path_ball  = ball;
+            path_ready = 1;
+        }
+
+        SDL_AtomicAdd(&path_want, 1);
+        SDL_CondSignal(path_cond);
+    }
+    SDL_UnlockMutex(path_mutex);
+}
+
+/*
+ * Draw the latest sampled path, if it is for the current aim.
+ */
+static void game_draw_path(void)
+{
+    if (view_m > 0.f && path_thread && config_get_d(CONFIG_PREVIEW))
+    {
+        int n = 0;
+
+        SDL_LockMutex(path_mutex);
+
+        if (path_done == SDL_AtomicGet(&path_want))
+            n = path_n;
+
+        if (n > 1)
+        {
+            glBindBuffer_(GL_ARRAY_BUFFER, 0);
+
+            glDisableClientState(GL_NORMAL_ARRAY);
+            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+            glDisable(GL_TEXTURE_2D);
+            glDisable(GL_LIGHTING);
+            {
+                glColor4f(1.0f, 1.0f, 1.0f, 0.5f);
+                glVertexPointer(3, GL_FLOAT, 0, path_p);
+                glDrawArrays(GL_LINE_STRIP, 0, n);
+                glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+            }
+            glEnable(GL_LIGHTING);
+            glEnable(GL_TEXTURE_2D);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glEnableClientState(GL_NORMAL_ARRAY);
+        }
+
+        SDL_UnlockMutex(path_mutex);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 int game_init(const char *s)
 {
     int i;
@@ -120,6 +385,7 @@ int game_init(const char *s)
 
 void game_free(void)
 {
+    path_free();
     sol_quit_sim();
     sol_free_full(&file);
 }
@@ -335,6 +601,7 @@ void game_draw(int pose, float t)
         {
             game_draw_balls(&rend, fp->vary, T, t);
             game_draw_vect(&rend, fp->vary);
+            game_draw_path();
         }
 
         glDisable(GL_LIGHTING);
@@ -563,15 +830,7 @@ int game_step(const float g[3], float dt)
 
 void game_putt(void)
 {
-    /*
-     * HACK: The BALL_FUDGE here  guarantees that a putt doesn't drive
-     * the ball  too directly down  toward a lump,  triggering rolling
-     * friction too early and stopping the ball prematurely.
-     */
-
-    file.vary.uv[ball].v[0] = -4.f * view_e[2][0] * view_m;
-    file.vary.uv[ball].v[1] = -4.f * view_e[2][1] * view_m + BALL_FUDGE;
-    file.vary.uv[ball].v[2] = -4.f * view_e[2][2] * view_m;
+    game_putt_v(file.vary.uv[ball].v);
 
     view_m = 0.f;
 }
@@ -39,6 +39,7 @@ void  game_free(void);
 
 void  game_draw(int, float);
 void  game_putt(void);
+void  game_aim(void);
 int   game_step(const float[3], float);
 
 void  game_update_view(float);
@@ -35,6 +35,8 @@
 #include "gui.h"
 #include "hmd.h"
 #include "fs.h"
+#include "prof.h"
+#include "frame.h"
 
 #include "st_conf.h"
 #include "st_all.h"
@@ -77,6 +79,35 @@ static void toggle_wire(void)
 
 /*---------------------------------------------------------------------------*/
 
+#define STATE(s) { &s, #s }
+
+/*
+ * Name the states that frame time statistics are broken down by.
+ */
+static void name_states(void)
+{
+    static const struct
+    {
+        struct state *st;
+        const char   *name;
+    } names[] = {
+        STATE(st_title),  STATE(st_course), STATE(st_party),
+        STATE(st_next),   STATE(st_flyby),  STATE(st_stroke),
+        STATE(st_roll),   STATE(st_goal),   STATE(st_stop),
+        STATE(st_fall),   STATE(st_score),  STATE(st_over),
+        STATE(st_pause),  STATE(st_conf)
+    };
+
+    int i;
+
+    for (i = 0; i < ARRAYSIZE(names); i++)
+        frame_name(names[i].st, names[i].name);
+}
+
+#undef STATE
+
+/*---------------------------------------------------------------------------*/
+
 static int loop(void)
 {
     SDL_Event e;
@@ -193,6 +224,9 @@ static int loop(void)
             case KEY_FPS:
                 config_tgl_d(CONFIG_FPS);
                 break;
+            case KEY_PROFILE:
+                PROF_DUMP();
+                break;
             case KEY_WIREFRAME:
                 toggle_wire();
                 break;
@@ -382,10 +416,12 @@ int main(int argc, char *argv[])
 
             /* Material system. */
 
+            image_init();
             mtrl_init();
 
             /* Run the main game loop. */
 
+            name_states();
             init_state(&st_null);
 
             if (opt_hole)
@@ -416,6 +452,7 @@ int main(int argc, char *argv[])
                 if ((t1 = SDL_GetTicks()) > t0)
                 {
                     st_timer((t1 - t0) / 1000.f);
+                    image_sync(0);
                     hmd_step();
                     st_paint(0.001f * t1);
                     video_swap();
@@ -427,12 +464,20 @@ int main(int argc, char *argv[])
                 }
 
             mtrl_quit();
+            image_quit();
         }
 
         /* Restore Neverball's camera setting. */
 
         config_set_d(CONFIG_CAMERA, camera);
         config_save();
+        config_quit();
+
+        PROF_DUMP();
+
+        frame_save("frames.csv");
+
+        log_printf("File lookups saved by the cache: %d\n", fs_cache_saved());
 
         SDL_Quit();
     }
@@ -988,6 +988,7 @@ static void stroke_timer(int id, float dt)
 
     game_update_view(dt);
     game_step(g, dt);
+    game_aim();
 }
 
 static int hittest = 0;
@@ -0,0 +1,113 @@
+#!/bin/sh
+
+# Summarize the level load events in one or more logs, as written by the
+# game (neverballrc log) or by loadbench: mean and worst time per stage
+# across all loads, then per level, slowest first.
+#
+#     scripts/load-summary.sh [log]...
+
+LC_ALL=C
+export LC_ALL
+
+grep -h '^{"event":"load"' "$@" | awk '
+function num(key,    s)
+{
+    if (match($0, "\"" key "\":[0-9.]+"))
+    {
+        s = substr($0, RSTART, RLENGTH)
+        sub(/.*:/, "", s)
+        return s + 0
+    }
+    return -1
+}
+
+{
+    loads++
+
+    match($0, /"level":"[^"]*"/)
+    level = substr($0, RSTART + 9, RLENGTH - 10)
+
+    total = num("total_ms")
+
+    if (!(level in lv_n))
+        order[++levels] = level
+
+    lv_n[level]++
+    lv_sum[level] += total
+    if (total > lv_max[level]) lv_max[level] = total
+
+    if ((ff = num("first_frame_ms")) >= 0)
+    {
+        ff_n++
+        ff_sum += ff
+        if (ff > ff_max) ff_max = ff
+    }
+
+    sum_total += total
+    if (total > max_total) max_total = total
+
+    # Stages are "name":[ms,count] pairs.
+
+    rest = $0
+    sub(/.*"stages":\{/, "", rest)
+
+    while (match(rest, /"[a-z_0-9]+":\[[0-9.]+,[0-9]+\]/))
+    {
+        pair = substr(rest, RSTART, RLENGTH)
+        rest = substr(rest, RSTART + RLENGTH)
+
+        name = pair
+        sub(/^"/, "", name)
+        sub(/".*/, "", name)
+
+        ms = pair
+        sub(/.*\[/, "", ms)
+        n = ms
+        sub(/,.*/, "", ms)
+        sub(/.*,/, "", n)
+        sub(/\]/, "", n)
+
+        if (!(name in st_ms))
+            st_order[++stages] = name
+
+        st_ms[name]    += ms
+        st_calls[name] += n
+        if (ms + 0 > st_max[name]) st_max[name] = ms + 0
+    }
+}
+
+END {
+    if (loads == 0)
+    {
+        print "No load events found." > "/dev/stderr"
+        exit 1
+    }
+
+    printf "%d loads, %d levels\n\n", loads, levels
+
+    printf "%-24s %10s %10s %8s\n", "stage", "mean_ms", "max_ms", "calls"
+
+    if (ff_n)
+        printf "%-24s %10.3f %10.3f %8d\n", "first_frame", \
+               ff_sum / ff_n, ff_max, ff_n
+
+    printf "%-24s %10.3f %10.3f %8d\n", "total", \
+           sum_total / loads, max_total, loads
+
+    for (i = 1; i <= stages; i++)
+    {
+        name = st_order[i]
+        printf "%-24s %10.3f %10.3f %8d\n", name, \
+               st_ms[name] / loads, st_max[name], st_calls[name]
+    }
+
+    printf "\n%-40s %10s %10s %6s\n", "level", "mean_ms", "max_ms", "loads"
+
+    for (i = 1; i <= levels; i++)
+    {
+        level = order[i]
+        printf "%-40s %10.3f %10.3f %6d\n", level, \
+               lv_sum[level] / lv_n[level], lv_max[level], lv_n[level] \
+               | "sort -k2 -n -r"
+    }
+}'
@@ -26,6 +26,7 @@
 #include "common.h"
 #include "fs.h"
 #include "fs_ov.h"
+#include "prof.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -199,6 +200,8 @@ static void audio_step(void *data, Uint8 *stream, int length)
     struct voice *V = voices;
     struct voice *P = NULL;
 
+    PROF_BEGIN("audio_step");
+
     /* Zero the output buffer. */
 
     memset(stream, 0, length);
@@ -246,6 +249,8 @@ static void audio_step(void *data, Uint8 *stream, int length)
             V = V->next;
         }
     }
+
+    PROF_END();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -86,25 +86,25 @@ void config_paths(const char *arg_data_path)
      * so far.
      */
 
-    /* Data directory. */
-
-    data = pick_data_path(arg_data_path);
-
-    fs_add_path_with_archives(data);
-
-    /* User directory. */
+    /* Set up the user directory for writing, create if needed. */
 
     home = pick_home_path();
     user = concat_string(home, "/", CONFIG_USER, NULL);
 
-    /* Set up directory for writing, create if needed. */
-
     if (!fs_set_write_dir(user))
     {
         if (!dir_make(user))
             fs_set_write_dir(user);
     }
 
+    /* Data directory. Archive indices are cached in the user directory. */
+
+    data = pick_data_path(arg_data_path);
+
+    fs_add_path_with_archives(data);
+
+    /* User directory. */
+
     fs_add_path_with_archives(user);
 
     free((void *) user);
@@ -16,10 +16,12 @@
 #include <jpeglib.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
 
 #include "base_config.h"
 #include "base_image.h"
+#include "ntx.h"
 
 #include "fs.h"
 #include "fs_png.h"
@@ -190,6 +192,29 @@ static void *image_load_jpg(const char *filename, int *width,
     return p;
 }
 
+/*
+ * Decode the top level of an NTX container.
+ */
+static void *image_load_ntx(const char *filename, int *width,
+                                                  int *height,
+                                                  int *bytes)
+{
+    struct ntx t;
+    void *p = NULL;
+
+    if (ntx_read(&t, filename))
+    {
+        if ((p = ntx_decode(&t, 0)))
+        {
+            if (width)  *width  = t.lv[0].w;
+            if (height) *height = t.lv[0].h;
+            if (bytes)  *bytes  = t.b;
+        }
+        ntx_free(&t);
+    }
+    return p;
+}
+
 void *image_load(const char *filename, int *width,
                                        int *height,
                                        int *bytes)
@@ -202,6 +227,8 @@ void *image_load(const char *filename, int *width,
             return image_load_png(filename, width, height, bytes);
         else if (strcmp(ext, ".jpg") == 0 || strcmp(ext, ".JPG") == 0)
             return image_load_jpg(filename, width, height, bytes);
+        else if (strcmp(ext, ".ntx") == 0)
+            return image_load_ntx(filename, width, height, bytes);
     }
     return NULL;
 }
@@ -246,43 +273,89 @@ void *image_next2(const void *p, int w, int h, int b, int *w2, int *h2)
 
 /*
  * Allocate and return a new down-sampled image buffer.
+ *
+ * Each group of N source rows is first summed column-wise into a row of
+ * 16-bit accumulators, which is a straight pass over contiguous bytes. Adjacent
+ * groups of N accumulators of the same component are then summed into each
+ * destination pixel.
  */
 void *image_scale(const void *p, int w, int h, int b, int *wn, int *hn, int n)
 {
-    unsigned char *src = (unsigned char *) p;
-    unsigned char *dst = NULL;
+    const unsigned char *src = (const unsigned char *) p;
+
+    unsigned char  *dst = NULL;
+    unsigned short *acc = NULL;
+
+    const int W = w / n;
+    const int H = h / n;
+
+    const int sl = w * b;               /* Source row stride.             */
+    const int al = W * n * b;           /* Accumulators per row.           */
+    const int dl = W * b;               /* Destination row stride.        */
+    const int nn = n * n;
 
-    int W = w / n;
-    int H = h / n;
+    assert(n >= 1 && n <= 257);
+
+    if (!(acc = (unsigned short *) malloc((al ? al : 1) * sizeof (*acc))))
+        return NULL;
 
     if ((dst = (unsigned char *) calloc(W * H * b, sizeof (unsigned char))))
     {
-        int si, di;
-        int sj, dj;
-        int i;
-
-        /* Iterate each component of each destination pixel. */
+        int di, dj, si, j, k;
 
         for (di = 0; di < H; di++)
-            for (dj = 0; dj < W; dj++)
-                for (i = 0; i < b; i++)
+        {
+            const unsigned char *s = src + di * n * sl;
+            unsigned char       *d = dst + di * dl;
+
+            /* Sum the N source rows of this block row. */
+
+            for (j = 0; j < al; j++)
+                acc[j] = s[j];
+
+            for (si = 1; si < n; si++)
+            {
+                s += sl;
+
+                for (j = 0; j < al; j++)
+                    acc[j] += s[j];
+            }
+
+            /* Sum each N-wide block and average. */
+
+            if (n == 2)
+            {
+                const unsigned short *a = acc;
+
+                for (dj = 0; dj < W; dj++, a += 2 * b, d += b)
+                    for (k = 0; k < b; k++)
+                        d[k] = (unsigned char) ((a[k] + a[k + b]) / 4);
+            }
+            else
+            {
+                for (dj = 0; dj < W; dj++)
                 {
-                    int c = 0;
+                    const unsigned short *a = acc + dj * n * b;
 
-                    /* Average the NxN source pixel block for each. */
+                    for (k = 0; k < b; k++)
+                    {
+                        unsigned int c = 0;
 
-                    for (si = di * n; si < (di + 1) * n; si++)
-                        for (sj = dj * n; sj < (dj + 1) * n; sj++)
-                            c += src[(si * w + sj) * b + i];
+                        for (j = k; j < n * b; j += b)
+                            c += a[j];
 
-                    dst[(di * W + dj) * b + i] =
-                        (unsigned char) (c / (n * n));
+                        d[dj * b + k] = (unsigned char) (c / nn);
+                    }
                 }
+            }
+        }
 
         if (wn) *wn = W;
         if (hn) *hn = H;
     }
 
+    free(acc);
+
     return dst;
 }
 
@@ -293,26 +366,35 @@ void image_white(void *p, int w, int h, int b)
 {
     unsigned char *s = (unsigned char *) p;
 
+    const int n = w * h;
     int i;
 
     assert(b >= 1 && b <= 4);
 
     if (b == 1 || b == 3)
     {
-        memset(s, 0xFF, w * h * b);
+        memset(s, 0xFF, n * b);
     }
     else if (b == 2)
     {
-        for (i = 0; i < w * h * b; i += 2)
-            s[i] = 0xFF;
+        for (i = 0; i < n; i++)
+            s[i * 2] = 0xFF;
     }
     else
     {
-        for (i = 0; i < w * h * b; i += 4)
+        /* OR each pixel with a byte-order neutral RGB mask. */
+
+        static const unsigned char m[4] = { 0xFF, 0xFF, 0xFF, 0x00 };
+
+        uint32_t mask, x;
+
+        memcpy(&mask, m, 4);
+
+        for (i = 0; i < n; i++)
         {
-            s[i + 0] = 0xFF;
-            s[i + 1] = 0xFF;
-            s[i + 2] = 0xFF;
+            memcpy(&x, s + i * 4, 4);
+            x |= mask;
+            memcpy(s + i * 4, &x, 4);
         }
     }
 }
@@ -323,6 +405,7 @@ void image_white(void *p, int w, int h, int b)
  */
 void *image_flip(const void *p, int w, int h, int b, int hflip, int vflip)
 {
+    const unsigned char *src = (const unsigned char *) p;
     unsigned char *q;
 
     assert(hflip || vflip);
@@ -332,20 +415,35 @@ void *image_flip(const void *p, int w, int h, int b, int hflip, int vflip)
 
     if ((q = malloc(w * b * h)))
     {
-        int r, c, i;
+        const int l = w * b;
+        int r, c;
 
         for (r = 0; r < h; r++)
-            for (c = 0; c < w; c++)
-                for (i = 0; i < b; i++)
-                {
-                    int pr = vflip ? h - r - 1 : r;
-                    int pc = hflip ? w - c - 1 : c;
+        {
+            const unsigned char *s = src + (vflip ? h - r - 1 : r) * l;
+            unsigned char       *d = q + r * l;
 
-                    int qi = r  * w * b + c  * b + i;
-                    int pi = pr * w * b + pc * b + i;
+            /* Rows copy whole, mirrored rows pixel by pixel. */
 
-                    q[qi] = ((const unsigned char *) p)[pi];
-                }
+            if (!hflip)
+                memcpy(d, s, l);
+
+            else if (b == 4)
+                for (c = 0; c < w; c++)
+                    memcpy(d + c * 4, s + (w - c - 1) * 4, 4);
+
+            else if (b == 3)
+                for (c = 0; c < w; c++)
+                    memcpy(d + c * 3, s + (w - c - 1) * 3, 3);
+
+            else if (b == 2)
+                for (c = 0; c < w; c++)
+                    memcpy(d + c * 2, s + (w - c - 1) * 2, 2);
+
+            else
+                for (c = 0; c < w; c++)
+                    d[c] = s[w - c - 1];
+        }
         return q;
     }
     return NULL;
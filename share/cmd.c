@@ -160,7 +160,7 @@ END_FUNC;
 
 GET_FUNC(CMD_SOUND)
 {
-    static char buff[MAXSTR];
+    char buff[MAXSTR];
 
     get_string(fp, buff, sizeof (buff));
 
@@ -687,7 +687,11 @@ int cmd_put(fs_file fp, const union cmd *cmd)
     return !fs_eof(fp);
 }
 
-int cmd_get(fs_file fp, union cmd *cmd)
+/*
+ * Read a command, skipping over the payload of any command whose entry in
+ * KEEP is zero. Skipped commands come back as CMD_NONE and never allocate.
+ */
+int cmd_get_only(fs_file fp, union cmd *cmd, const unsigned char *keep)
 {
     int type;
     short size;
@@ -699,9 +703,9 @@ int cmd_get(fs_file fp, union cmd *cmd)
     {
         size = get_short(fp);
 
-        /* Discard unrecognised commands. */
+        /* Discard unrecognised and unwanted commands. */
 
-        if (type >= CMD_MAX)
+        if (type >= CMD_MAX || (keep && !keep[type]))
         {
             fs_seek(fp, size, SEEK_CUR);
             type = CMD_NONE;
@@ -756,6 +760,11 @@ int cmd_get(fs_file fp, union cmd *cmd)
     return 0;
 }
 
+int cmd_get(fs_file fp, union cmd *cmd)
+{
+    return cmd_get_only(fp, cmd, NULL);
+}
+
 /*---------------------------------------------------------------------------*/
 
 void cmd_free(union cmd *cmd)
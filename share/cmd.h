@@ -337,6 +337,7 @@ union cmd
 
 int cmd_put(fs_file, const union cmd *);
 int cmd_get(fs_file, union cmd *);
+int cmd_get_only(fs_file, union cmd *, const unsigned char *);
 
 void cmd_free(union cmd *);
 
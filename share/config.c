@@ -22,6 +22,8 @@
 #include "config.h"
 #include "common.h"
 #include "fs.h"
+#include "hmap.h"
+#include "log.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -95,6 +97,7 @@ int CONFIG_KEY_BACKWARD;
 int CONFIG_KEY_LEFT;
 int CONFIG_KEY_RIGHT;
 int CONFIG_KEY_RESTART;
+int CONFIG_KEY_REWIND;
 int CONFIG_KEY_SCORE_NEXT;
 int CONFIG_KEY_ROTATE_FAST;
 int CONFIG_VIEW_FOV;
@@ -105,6 +108,10 @@ int CONFIG_ROTATE_FAST;
 int CONFIG_ROTATE_SLOW;
 int CONFIG_CHEAT;
 int CONFIG_STATS;
+int CONFIG_STEP_MAX;
+int CONFIG_STEP_DROP;
+int CONFIG_PREVIEW;
+int CONFIG_REWIND;
 int CONFIG_SCREENSHOT;
 int CONFIG_LOCK_GOALS;
 int CONFIG_CAMERA_1_SPEED;
@@ -118,6 +125,7 @@ int CONFIG_PLAYER;
 int CONFIG_BALL_FILE;
 int CONFIG_WIIMOTE_ADDR;
 int CONFIG_REPLAY_NAME;
+int CONFIG_GHOST;
 int CONFIG_LANGUAGE;
 int CONFIG_THEME;
 
@@ -201,6 +209,7 @@ static struct
     { &CONFIG_KEY_LEFT,          "key_left",          SDLK_LEFT },
     { &CONFIG_KEY_RIGHT,         "key_right",         SDLK_RIGHT },
     { &CONFIG_KEY_RESTART,       "key_restart",       SDLK_r },
+    { &CONFIG_KEY_REWIND,        "key_rewind",        SDLK_BACKSPACE },
     { &CONFIG_KEY_SCORE_NEXT,    "key_score_next",    SDLK_TAB },
     { &CONFIG_KEY_ROTATE_FAST,   "key_rotate_fast",   SDLK_LSHIFT },
 
@@ -212,6 +221,10 @@ static struct
     { &CONFIG_ROTATE_SLOW, "rotate_slow", 150 },
     { &CONFIG_CHEAT,       "cheat",       0 },
     { &CONFIG_STATS,       "stats",       0 },
+    { &CONFIG_STEP_MAX,    "step_max",    8 },
+    { &CONFIG_STEP_DROP,   "step_drop",   0 },
+    { &CONFIG_PREVIEW,     "preview",     0 },
+    { &CONFIG_REWIND,      "rewind",      0 },
     { &CONFIG_SCREENSHOT,  "screenshot",  0 },
     { &CONFIG_LOCK_GOALS,  "lock_goals",  0 },
 
@@ -231,6 +244,7 @@ static struct
     { &CONFIG_BALL_FILE,    "ball_file",    "ball/basic-ball/basic-ball" },
     { &CONFIG_WIIMOTE_ADDR, "wiimote_addr", "" },
     { &CONFIG_REPLAY_NAME,  "replay_name",  "%s-%l" },
+    { &CONFIG_GHOST,        "ghost",        "" },
     { &CONFIG_LANGUAGE,     "language",     "" },
     { &CONFIG_THEME,        "theme",        "classic" }
 };
@@ -239,6 +253,31 @@ static int dirty = 0;
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Option names map to i + 1 for integer option i and -(i + 1) for string
+ * option i.
+ */
+
+static Hmap option_names;
+
+static const char *name_of(int c)
+{
+    return c > 0 ? option_d[c - 1].name : option_s[-c - 1].name;
+}
+
+static void name_add(int c)
+{
+    if (option_names)
+        hmap_put(option_names, name_of(c), c);
+}
+
+static int name_find(const char *name)
+{
+    return option_names ? hmap_get(option_names, name, 0) : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void config_key(const char *s, int i)
 {
     SDL_Keycode c = SDL_GetKeyFromName(s);
@@ -292,16 +331,23 @@ void config_init(void)
      * initialise current values with defaults.
      */
 
+    if (option_names)
+        hmap_clear(option_names);
+    else
+        option_names = hmap_new();
+
     for (i = 0; i < ARRAYSIZE(option_d); i++)
     {
         *option_d[i].sym = i;
         config_set_d(i, option_d[i].def);
+        name_add(i + 1);
     }
 
     for (i = 0; i < ARRAYSIZE(option_s); i++)
     {
         *option_s[i].sym = i;
         config_set_s(i, option_s[i].def);
+        name_add(-(i + 1));
     }
 }
 
@@ -354,60 +400,45 @@ void config_load(void)
         {
             if (scan_key_and_value(&key, &val, line))
             {
-                int i;
+                int i, c = name_find(key);
 
-                /* Look up an integer option by that name. */
-
-                for (i = 0; i < ARRAYSIZE(option_d); i++)
+                if (c > 0)
                 {
-                    if (strcmp(key, option_d[i].name) == 0)
-                    {
-                        /* Translate some strings to integers. */
-
-                        if (i == CONFIG_MOUSE_CAMERA_1      ||
-                            i == CONFIG_MOUSE_CAMERA_2      ||
-                            i == CONFIG_MOUSE_CAMERA_3      ||
-                            i == CONFIG_MOUSE_CAMERA_TOGGLE ||
-                            i == CONFIG_MOUSE_CAMERA_L      ||
-                            i == CONFIG_MOUSE_CAMERA_R)
-                        {
-                            config_mouse(val, i);
-                        }
-                        else if (i == CONFIG_KEY_FORWARD       ||
-                                 i == CONFIG_KEY_BACKWARD      ||
-                                 i == CONFIG_KEY_LEFT          ||
-                                 i == CONFIG_KEY_RIGHT         ||
-                                 i == CONFIG_KEY_CAMERA_1      ||
-                                 i == CONFIG_KEY_CAMERA_2      ||
-                                 i == CONFIG_KEY_CAMERA_3      ||
-                                 i == CONFIG_KEY_CAMERA_TOGGLE ||
-                                 i == CONFIG_KEY_CAMERA_R      ||
-                                 i == CONFIG_KEY_CAMERA_L      ||
-                                 i == CONFIG_KEY_RESTART       ||
-                                 i == CONFIG_KEY_SCORE_NEXT    ||
-                                 i == CONFIG_KEY_ROTATE_FAST)
-                        {
-                            config_key(val, i);
-                        }
-                        else
-                            config_set_d(i, atoi(val));
-
-                        /* Stop looking. */
-
-                        break;
-                    }
-                }
+                    i = c - 1;
 
-                /* Look up a string option by that name.*/
+                    /* Translate some strings to integers. */
 
-                for (i = 0; i < ARRAYSIZE(option_s); i++)
-                {
-                    if (strcmp(key, option_s[i].name) == 0)
+                    if (i == CONFIG_MOUSE_CAMERA_1      ||
+                        i == CONFIG_MOUSE_CAMERA_2      ||
+                        i == CONFIG_MOUSE_CAMERA_3      ||
+                        i == CONFIG_MOUSE_CAMERA_TOGGLE ||
+                        i == CONFIG_MOUSE_CAMERA_L      ||
+                        i == CONFIG_MOUSE_CAMERA_R)
                     {
-                        config_set_s(i, val);
-                        break;
+                        config_mouse(val, i);
                     }
+                    else if (i == CONFIG_KEY_FORWARD       ||
+                             i == CONFIG_KEY_BACKWARD      ||
+                             i == CONFIG_KEY_LEFT          ||
+                             i == CONFIG_KEY_RIGHT         ||
+                             i == CONFIG_KEY_CAMERA_1      ||
+                             i == CONFIG_KEY_CAMERA_2      ||
+                             i == CONFIG_KEY_CAMERA_3      ||
+                             i == CONFIG_KEY_CAMERA_TOGGLE ||
+                             i == CONFIG_KEY_CAMERA_R      ||
+                             i == CONFIG_KEY_CAMERA_L      ||
+                             i == CONFIG_KEY_RESTART       ||
+                             i == CONFIG_KEY_REWIND        ||
+                             i == CONFIG_KEY_SCORE_NEXT    ||
+                             i == CONFIG_KEY_ROTATE_FAST)
+                    {
+                        config_key(val, i);
+                    }
+                    else
+                        config_set_d(i, atoi(val));
                 }
+                else if (c < 0)
+                    config_set_s(-c - 1, val);
             }
             free(line);
         }
@@ -417,78 +448,241 @@ void config_load(void)
     }
 }
 
-void config_save(void)
+/*
+ * Format all options as they are written to the config file.
+ */
+static char *config_text(void)
 {
-    fs_file fh;
+    size_t size = 1, n = 0;
+    char *text;
+    int i;
 
-    SDL_assert(SDL_WasInit(SDL_INIT_VIDEO));
+    for (i = 0; i < ARRAYSIZE(option_d); i++)
+        size += strlen(option_d[i].name) + 26 + MAXSTR;
+    for (i = 0; i < ARRAYSIZE(option_s); i++)
+        size += strlen(option_s[i].name) + 26 + strlen(option_s[i].cur) + 1;
+
+    if (!(text = malloc(size)))
+        return NULL;
+
+    /* Write out integer options. */
 
-    if (dirty && (fh = fs_open(USER_CONFIG_FILE, "w")))
+    for (i = 0; i < ARRAYSIZE(option_d); i++)
     {
-        int i;
+        const char *s = NULL;
 
-        /* Write out integer options. */
+        /* Translate some integers to strings. */
 
-        for (i = 0; i < ARRAYSIZE(option_d); i++)
+        if (i == CONFIG_MOUSE_CAMERA_1      ||
+            i == CONFIG_MOUSE_CAMERA_2      ||
+            i == CONFIG_MOUSE_CAMERA_3      ||
+            i == CONFIG_MOUSE_CAMERA_TOGGLE ||
+            i == CONFIG_MOUSE_CAMERA_L      ||
+            i == CONFIG_MOUSE_CAMERA_R)
+        {
+            s = config_mouse_name(option_d[i].cur);
+        }
+        else if (i == CONFIG_KEY_FORWARD       ||
+                 i == CONFIG_KEY_BACKWARD      ||
+                 i == CONFIG_KEY_LEFT          ||
+                 i == CONFIG_KEY_RIGHT         ||
+                 i == CONFIG_KEY_CAMERA_1      ||
+                 i == CONFIG_KEY_CAMERA_2      ||
+                 i == CONFIG_KEY_CAMERA_3      ||
+                 i == CONFIG_KEY_CAMERA_TOGGLE ||
+                 i == CONFIG_KEY_CAMERA_R      ||
+                 i == CONFIG_KEY_CAMERA_L      ||
+                 i == CONFIG_KEY_RESTART       ||
+                 i == CONFIG_KEY_REWIND        ||
+                 i == CONFIG_KEY_SCORE_NEXT    ||
+                 i == CONFIG_KEY_ROTATE_FAST)
         {
-            const char *s = NULL;
+            s = SDL_GetKeyName((SDL_Keycode) option_d[i].cur);
+        }
+        else if (i == CONFIG_CHEAT)
+        {
+            if (!config_cheat())
+                continue;
+        }
 
-            /* Translate some integers to strings. */
+        if (s)
+            n += snprintf(text + n, size - n, "%-25s %.*s\n",
+                          option_d[i].name, MAXSTR - 1, s);
+        else
+            n += snprintf(text + n, size - n, "%-25s %d\n",
+                          option_d[i].name, option_d[i].cur);
+    }
 
-            if (i == CONFIG_MOUSE_CAMERA_1      ||
-                i == CONFIG_MOUSE_CAMERA_2      ||
-                i == CONFIG_MOUSE_CAMERA_3      ||
-                i == CONFIG_MOUSE_CAMERA_TOGGLE ||
-                i == CONFIG_MOUSE_CAMERA_L      ||
-                i == CONFIG_MOUSE_CAMERA_R)
-            {
-                s = config_mouse_name(option_d[i].cur);
-            }
-            else if (i == CONFIG_KEY_FORWARD       ||
-                     i == CONFIG_KEY_BACKWARD      ||
-                     i == CONFIG_KEY_LEFT          ||
-                     i == CONFIG_KEY_RIGHT         ||
-                     i == CONFIG_KEY_CAMERA_1      ||
-                     i == CONFIG_KEY_CAMERA_2      ||
-                     i == CONFIG_KEY_CAMERA_3      ||
-                     i == CONFIG_KEY_CAMERA_TOGGLE ||
-                     i == CONFIG_KEY_CAMERA_R      ||
-                     i == CONFIG_KEY_CAMERA_L      ||
-                     i == CONFIG_KEY_RESTART       ||
-                     i == CONFIG_KEY_SCORE_NEXT    ||
-                     i == CONFIG_KEY_ROTATE_FAST)
+    /* Write out string options. */
+
+    for (i = 0; i < ARRAYSIZE(option_s); i++)
+        n += snprintf(text + n, size - n, "%-25s %s\n",
+                      option_s[i].name, option_s[i].cur);
+
+    return text;
+}
+
+/*
+ * Write the config file by way of a temporary file, so that an
+ * interrupted or failed write never leaves a truncated config behind.
+ */
+static void config_write(const char *text)
+{
+    fs_file fh;
+
+    if ((fh = fs_open(USER_CONFIG_FILE ".tmp", "w")))
+    {
+        int ok = (fs_puts(text, fh) >= 0);
+
+        if (fs_close(fh) && ok)
+            fs_rename(USER_CONFIG_FILE ".tmp", USER_CONFIG_FILE);
+        else
+        {
+            log_printf("Failure to write %s\n", USER_CONFIG_FILE);
+            fs_remove(USER_CONFIG_FILE ".tmp");
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Saves are handed to a writer thread. A save requested while another
+ * is pending replaces it, and the writer waits for requests to settle
+ * before it writes.
+ */
+
+#define SAVE_DELAY 500                  /* Milliseconds                      */
+
+static SDL_Thread *save_thread;
+static SDL_mutex  *save_mutex;
+static SDL_cond   *save_cond;
+static char       *save_text;
+static int         save_stop;
+
+static int save_func(void *data)
+{
+    char *text;
+
+    SDL_LockMutex(save_mutex);
+
+    while (save_text || !save_stop)
+    {
+        if (save_text)
+        {
+            /* Wait out a burst of saves, unless quitting. */
+
+            if (!save_stop &&
+                SDL_CondWaitTimeout(save_cond, save_mutex, SAVE_DELAY) == 0)
+                continue;
+
+            text      = save_text;
+            save_text = NULL;
+
+            SDL_UnlockMutex(save_mutex);
             {
-                s = SDL_GetKeyName((SDL_Keycode) option_d[i].cur);
+                config_write(text);
+                free(text);
             }
-            else if (i == CONFIG_CHEAT)
+            SDL_LockMutex(save_mutex);
+        }
+        else SDL_CondWait(save_cond, save_mutex);
+    }
+
+    SDL_UnlockMutex(save_mutex);
+
+    return 0;
+}
+
+static int save_init(void)
+{
+    if (save_thread)
+        return 1;
+
+    if ((save_mutex = SDL_CreateMutex()) &&
+        (save_cond  = SDL_CreateCond()))
+    {
+        save_stop = 0;
+
+        if ((save_thread = SDL_CreateThread(save_func, "config", NULL)))
+            return 1;
+    }
+
+    if (save_cond)  SDL_DestroyCond (save_cond);
+    if (save_mutex) SDL_DestroyMutex(save_mutex);
+
+    save_cond  = NULL;
+    save_mutex = NULL;
+
+    return 0;
+}
+
+/*
+ * Queue the options for writing, if any changed. This does not block.
+ */
+void config_save(void)
+{
+    char *text;
+
+    SDL_assert(SDL_WasInit(SDL_INIT_VIDEO));
+
+    if (dirty && (text = config_text()))
+    {
+        if (save_init())
+        {
+            SDL_LockMutex(save_mutex);
             {
-                if (!config_cheat())
-                    continue;
+                free(save_text);
+                save_text = text;
+                SDL_CondSignal(save_cond);
             }
-
-            if (s)
-                fs_printf(fh, "%-25s %s\n", option_d[i].name, s);
-            else
-                fs_printf(fh, "%-25s %d\n", option_d[i].name, option_d[i].cur);
+            SDL_UnlockMutex(save_mutex);
+        }
+        else
+        {
+            config_write(text);
+            free(text);
         }
+    }
 
-        /* Write out string options. */
+    dirty = 0;
+}
 
-        for (i = 0; i < ARRAYSIZE(option_s); i++)
-            fs_printf(fh, "%-25s %s\n", option_s[i].name, option_s[i].cur);
+/*
+ * Finish any pending save, stop the writer and drop the option names.
+ */
+void config_quit(void)
+{
+    if (save_thread)
+    {
+        SDL_LockMutex(save_mutex);
+        save_stop = 1;
+        SDL_CondSignal(save_cond);
+        SDL_UnlockMutex(save_mutex);
 
-        fs_close(fh);
+        SDL_WaitThread(save_thread, NULL);
+
+        SDL_DestroyCond (save_cond);
+        SDL_DestroyMutex(save_mutex);
+
+        save_thread = NULL;
+        save_cond   = NULL;
+        save_mutex  = NULL;
     }
 
-    dirty = 0;
+    hmap_free(option_names);
+    option_names = NULL;
 }
 
 /*---------------------------------------------------------------------------*/
 
 void config_set_d(int i, int d)
 {
-    option_d[i].cur = d;
-    dirty = 1;
+    if (option_d[i].cur != d)
+    {
+        option_d[i].cur = d;
+        dirty = 1;
+    }
 }
 
 void config_tgl_d(int i)
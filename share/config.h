@@ -92,6 +92,7 @@ extern int CONFIG_KEY_BACKWARD;
 extern int CONFIG_KEY_LEFT;
 extern int CONFIG_KEY_RIGHT;
 extern int CONFIG_KEY_RESTART;
+extern int CONFIG_KEY_REWIND;
 extern int CONFIG_KEY_SCORE_NEXT;
 extern int CONFIG_KEY_ROTATE_FAST;
 extern int CONFIG_VIEW_FOV;
@@ -102,6 +103,10 @@ extern int CONFIG_ROTATE_FAST;
 extern int CONFIG_ROTATE_SLOW;
 extern int CONFIG_CHEAT;
 extern int CONFIG_STATS;
+extern int CONFIG_STEP_MAX;
+extern int CONFIG_STEP_DROP;
+extern int CONFIG_PREVIEW;
+extern int CONFIG_REWIND;
 extern int CONFIG_SCREENSHOT;
 extern int CONFIG_LOCK_GOALS;
 extern int CONFIG_CAMERA_1_SPEED;
@@ -114,6 +119,7 @@ extern int CONFIG_PLAYER;
 extern int CONFIG_BALL_FILE;
 extern int CONFIG_WIIMOTE_ADDR;
 extern int CONFIG_REPLAY_NAME;
+extern int CONFIG_GHOST;
 extern int CONFIG_LANGUAGE;
 extern int CONFIG_THEME;
 
@@ -122,6 +128,7 @@ extern int CONFIG_THEME;
 void config_init(void);
 void config_load(void);
 void config_save(void);
+void config_quit(void);
 
 /*---------------------------------------------------------------------------*/
 
@@ -155,6 +162,7 @@ int config_screenshot(void);
 #define KEY_LEVELSHOTS SDLK_F8
 
 #define KEY_FPS        SDLK_F9
+#define KEY_PROFILE    SDLK_F11
 #define KEY_POSE       SDLK_F10
 #define KEY_SCREENSHOT SDLK_F12
 
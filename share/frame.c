@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "frame.h"
+#include "common.h"
+#include "log.h"
+#include "fs.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Times are kept in microseconds. Each power of two is split into
+ * HIST_SUB linear bins, for a precision of about 1/HIST_SUB across the
+ * whole range, as in HDR histograms.
+ */
+
+#define HIST_BITS 4
+#define HIST_SUB  (1 << HIST_BITS)
+#define HIST_EXP  28                    /* Up to 2^28 us, about 4.5 minutes  */
+#define HIST_LEN  (HIST_EXP * HIST_SUB)
+
+#define KEY_MAX   64                    /* Tracked states                    */
+
+#define BUDGET_60 16667                 /* Frame budgets in microseconds     */
+#define BUDGET_30 33333
+
+struct hist
+{
+    unsigned int bin[HIST_LEN];
+
+    int    count;
+    int    over_60;
+    int    over_30;
+    double sum;
+    int    max;
+};
+
+static struct hist total;
+static struct hist window;
+
+static struct
+{
+    const void *key;
+    const char *name;
+    struct hist hist;
+} keys[KEY_MAX];
+
+static int key_count;
+
+/*---------------------------------------------------------------------------*/
+
+static int hist_bin(int us)
+{
+    int e = 0;
+
+    if (us < HIST_SUB)
+        return MAX(us, 0);
+
+    /* Find the power of two, then the linear bin within it. */
+
+    while ((us >> e) >= 2 * HIST_SUB)
+        e++;
+
+    if (e + 1 >= HIST_EXP)
+        return HIST_LEN - 1;
+
+    return (e + 1) * HIST_SUB + ((us >> e) - HIST_SUB);
+}
+
+static int hist_val(int b)
+{
+    int e = b / HIST_SUB;
+    int m = b % HIST_SUB;
+
+    /* Middle of the bin. */
+
+    if (e == 0)
+        return m;
+
+    return ((HIST_SUB + m) << (e - 1)) + ((1 << (e - 1)) >> 1);
+}
+
+static void hist_add(struct hist *h, int us)
+{
+    h->bin[hist_bin(us)]++;
+
+    h->count++;
+    h->sum += us;
+
+    if (us > BUDGET_60) h->over_60++;
+    if (us > BUDGET_30) h->over_30++;
+    if (us > h->max)    h->max = us;
+}
+
+static float hist_pct(const struct hist *h, double p)
+{
+    int n = (int) (p * h->count + 0.5), c = 0, b;
+
+    for (b = 0; b < HIST_LEN; b++)
+        if ((c += h->bin[b]) >= n && c > 0)
+            return MIN(hist_val(b), h->max) / 1000.0f;
+
+    return h->max / 1000.0f;
+}
+
+static void hist_get(const struct hist *h, struct frame_stat *s)
+{
+    memset(s, 0, sizeof (*s));
+
+    if ((s->frames = h->count))
+    {
+        s->over_60 = h->over_60;
+        s->over_30 = h->over_30;
+        s->mean    = (float) (h->sum / h->count / 1000.0);
+        s->p50     = hist_pct(h, 0.50);
+        s->p95     = hist_pct(h, 0.95);
+        s->p99     = hist_pct(h, 0.99);
+        s->max     = h->max / 1000.0f;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int key_find(const void *key, int add)
+{
+    int i;
+
+    for (i = 0; i < key_count; i++)
+        if (keys[i].key == key)
+            return i;
+
+    if (add && key_count < KEY_MAX)
+    {
+        keys[key_count].key  = key;
+        keys[key_count].name = NULL;
+        return key_count++;
+    }
+    return -1;
+}
+
+/*
+ * Record the time of one frame rendered while KEY was current.
+ */
+void frame_time(float ms, const void *key)
+{
+    int us = (int) (ms * 1000.0f);
+    int i;
+
+    hist_add(&total,  us);
+    hist_add(&window, us);
+
+    if (key && (i = key_find(key, 1)) >= 0)
+        hist_add(&keys[i].hist, us);
+}
+
+void frame_name(const void *key, const char *name)
+{
+    int i;
+
+    if ((i = key_find(key, 1)) >= 0)
+        keys[i].name = name;
+}
+
+/*
+ * Return statistics for frames since the last call.
+ */
+void frame_window(struct frame_stat *s)
+{
+    hist_get(&window, s);
+    memset(&window, 0, sizeof (window));
+}
+
+void frame_total(struct frame_stat *s)
+{
+    hist_get(&total, s);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void save_row(fs_file fp, const char *name, const struct hist *h)
+{
+    struct frame_stat s;
+
+    hist_get(h, &s);
+
+    fs_printf(fp, "%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%d\n", name, s.frames,
+              s.mean, s.p50, s.p95, s.p99, s.max, s.over_60, s.over_30);
+}
+
+/*
+ * Write the overall and per-state statistics as CSV.
+ */
+int frame_save(const char *path)
+{
+    fs_file fp;
+    int i;
+
+    if (total.count == 0)
+        return 0;
+
+    if ((fp = fs_open(path, "w")))
+    {
+        fs_puts("state,frames,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,"
+                "over_60hz,over_30hz\n", fp);
+
+        save_row(fp, "all", &total);
+
+        for (i = 0; i < key_count; i++)
+            if (keys[i].hist.count)
+            {
+                char name[MAXSTR];
+
+                if (keys[i].name)
+                    SAFECPY(name, keys[i].name);
+                else
+                    sprintf(name, "state%02d", i);
+
+                save_row(fp, name, &keys[i].hist);
+            }
+
+        fs_close(fp);
+        return 1;
+    }
+
+    log_printf("Failure to write %s\n", path);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
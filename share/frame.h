@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Frame time statistics. Frame times are binned into log-linear
+ * histograms, overall, per second and per screen state, from which
+ * percentiles and counts of frames over budget are read back.
+ */
+
+struct frame_stat
+{
+    int   frames;
+    int   over_60;                      /* Frames longer than 1/60 s         */
+    int   over_30;                      /* Frames longer than 1/30 s         */
+    float mean;
+    float p50;
+    float p95;
+    float p99;
+    float max;                          /* All times in milliseconds         */
+};
+
+void frame_time(float ms, const void *key);
+void frame_name(const void *key, const char *name);
+
+void frame_window(struct frame_stat *);
+void frame_total (struct frame_stat *);
+
+int  frame_save(const char *path);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
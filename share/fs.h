@@ -18,6 +18,11 @@ int fs_exists(const char *);
 int fs_remove(const char *);
 int fs_rename(const char *, const char *);
 
+const char *fs_real_dir(const char *);
+long        fs_mtime(const char *);
+
+int fs_cache_saved(void);
+
 fs_file fs_open(const char *path, const char *mode);
 int     fs_close(fs_file);
 
@@ -0,0 +1,49 @@
+#ifndef FS_BUF_H
+#define FS_BUF_H
+
+#include "fs.h"
+
+/*
+ * Every backend's struct fs_file_s begins with one of these. It buffers
+ * reads and writes in user space so that the common layer can get and
+ * put single bytes without calling into the backend. A handle is either
+ * reading ahead or collecting writes, never both. A read handle may
+ * instead hold the whole file in memory, in which case the backend is
+ * never called.
+ */
+
+#define FS_BUF_SIZE 0x2000
+
+struct fs_buf
+{
+    unsigned char *rpos;                /* Next byte to read                 */
+    unsigned char *rend;                /* End of bytes read ahead           */
+    unsigned char *wpos;                /* Next byte to write                */
+    unsigned char *wend;                /* End of room to write              */
+    unsigned char *mem;                 /* Whole file, or NULL               */
+
+    unsigned char data[FS_BUF_SIZE];
+};
+
+#define FS_BUF(fh) ((struct fs_buf *) (fh))
+
+void fs_buf_init(fs_file);
+int  fs_buf_drain(fs_file);
+
+/* Unbuffered backend primitives, counting bytes. */
+
+int  fs_raw_read  (void *, int, fs_file);
+int  fs_raw_write (const void *, int, fs_file);
+int  fs_raw_flush (fs_file);
+long fs_raw_tell  (fs_file);
+int  fs_raw_seek  (fs_file, long, int);
+int  fs_raw_eof   (fs_file);
+int  fs_raw_length(fs_file);
+
+/* Existence of virtual paths, as last seen by the backend. */
+
+int  fs_cache_get  (const char *);
+void fs_cache_put  (const char *, int);
+void fs_cache_clear(void);
+
+#endif
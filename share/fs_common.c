@@ -17,9 +17,17 @@
 #include <assert.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
 #include "fs.h"
+#include "fs_buf.h"
 #include "dir.h"
 #include "array.h"
+#include "hmap.h"
 #include "common.h"
 
 /*
@@ -41,12 +49,17 @@ static int is_archive(struct dir_item *item)
             str_ends_with(item->path, ".pk3"));
 }
 
-static void add_archives(const char *path)
+static int is_bundle(struct dir_item *item)
+{
+    return str_ends_with(item->path, ".nbp");
+}
+
+static void add_archives(const char *path, int (*filter)(struct dir_item *))
 {
     Array archives;
     int i;
 
-    if ((archives = dir_scan(path, is_archive, NULL, NULL)))
+    if ((archives = dir_scan(path, filter, NULL, NULL)))
     {
         array_sort(archives, cmp_dir_items);
 
@@ -57,10 +70,21 @@ static void add_archives(const char *path)
     }
 }
 
+/*
+ * Add a directory along with the archives in it. Archives are added
+ * first, so that loose files override them. Bundles go last: they are
+ * built from the files next to them and stand in for them. A bundle
+ * older than those files is not mounted.
+ */
 int fs_add_path_with_archives(const char *path)
 {
-    add_archives(path);
-    return fs_add_path(path);
+    int rc;
+
+    add_archives(path, is_archive);
+    rc = fs_add_path(path);
+    add_archives(path, is_bundle);
+
+    return rc;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -80,6 +104,9 @@ int fs_rename(const char *src, const char *dst)
 
         free(real_src);
         free(real_dst);
+
+        fs_cache_put(src, 0);
+        fs_cache_put(dst, 0);
     }
 
     return rc;
@@ -87,10 +114,295 @@ int fs_rename(const char *src, const char *dst)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Lookup cache. Remembers whether virtual paths exist, so that probing a
+ * list of candidate names, as texture and material loading do, searches
+ * the mounted paths once per name and run. The backends clear it when
+ * the search path or write directory changes and update it as files are
+ * written or removed. Image loader threads probe concurrently, hence
+ * the lock.
+ */
+
+/* Path states: 1 exists, -1 missing. Unknown paths are not stored. */
+
+static Hmap cache;
+static int  cache_saved;
+
+#ifdef _WIN32
+static SRWLOCK cache_lock = SRWLOCK_INIT;
+#define cache_enter() AcquireSRWLockExclusive(&cache_lock)
+#define cache_leave() ReleaseSRWLockExclusive(&cache_lock)
+#else
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define cache_enter() pthread_mutex_lock(&cache_lock)
+#define cache_leave() pthread_mutex_unlock(&cache_lock)
+#endif
+
+/*
+ * Return the known state of a path, counting the failed search saved if
+ * it is missing.
+ */
+int fs_cache_get(const char *path)
+{
+    int state = 0;
+
+    cache_enter();
+    {
+        if (cache && (state = hmap_get(cache, path, 0)) < 0)
+            cache_saved++;
+    }
+    cache_leave();
+
+    return state;
+}
+
+void fs_cache_put(const char *path, int state)
+{
+    cache_enter();
+    {
+        if (!cache && state)
+            cache = hmap_new();
+
+        if (cache)
+        {
+            if (state)
+                hmap_put(cache, path, state);
+            else
+                hmap_del(cache, path);
+        }
+    }
+    cache_leave();
+}
+
+void fs_cache_clear(void)
+{
+    cache_enter();
+    {
+        hmap_free(cache);
+        cache = NULL;
+    }
+    cache_leave();
+}
+
+int fs_cache_saved(void)
+{
+    return cache_saved;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Buffered I/O on top of the backend primitives.
+ */
+
+void fs_buf_init(fs_file fh)
+{
+    struct fs_buf *b = FS_BUF(fh);
+
+    b->rpos = b->rend = b->data;
+    b->wpos = b->wend = b->data;
+    b->mem  = NULL;
+}
+
+/*
+ * Write out collected bytes and leave write mode.
+ */
+int fs_buf_drain(fs_file fh)
+{
+    struct fs_buf *b = FS_BUF(fh);
+    int n = (int) (b->wpos - b->data);
+    int rc = 1;
+
+    if (n > 0 && fs_raw_write(b->data, n, fh) != n)
+        rc = 0;
+
+    b->wpos = b->wend = b->data;
+
+    return rc;
+}
+
+/*
+ * Drop bytes read ahead, moving the backend back to the logical position.
+ */
+static void buf_unread(fs_file fh)
+{
+    struct fs_buf *b = FS_BUF(fh);
+
+    if (b->rpos < b->rend)
+        fs_raw_seek(fh, (long) (b->rpos - b->rend), SEEK_CUR);
+
+    b->rpos = b->rend = b->data;
+}
+
+int fs_read(void *data, int size, int count, fs_file fh)
+{
+    struct fs_buf *b = FS_BUF(fh);
+    unsigned char *dst = data;
+
+    int want = size * count;
+    int got  = 0;
+    int n;
+
+    if (want <= 0)
+        return 0;
+
+    if (b->wpos > b->data)
+        fs_buf_drain(fh);
+
+    /* Take what is read ahead. */
+
+    n = MIN(want, (int) (b->rend - b->rpos));
+
+    memcpy(dst, b->rpos, n);
+    b->rpos += n;
+    got     += n;
+
+    /* Read large requests directly, small ones through the buffer. */
+
+    if (got < want && !b->mem)
+    {
+        if (want - got >= FS_BUF_SIZE)
+        {
+            if ((n = fs_raw_read(dst + got, want - got, fh)) > 0)
+                got += n;
+        }
+        else if ((n = fs_raw_read(b->data, FS_BUF_SIZE, fh)) > 0)
+        {
+            b->rpos = b->data;
+            b->rend = b->data + n;
+
+            n = MIN(want - got, n);
+
+            memcpy(dst + got, b->rpos, n);
+            b->rpos += n;
+            got     += n;
+        }
+    }
+
+    return got / size;
+}
+
+int fs_write(const void *data, int size, int count, fs_file fh)
+{
+    struct fs_buf *b = FS_BUF(fh);
+    int len = size * count;
+    int n;
+
+    if (len <= 0 || b->mem)
+        return 0;
+
+    if (b->rpos < b->rend)
+        buf_unread(fh);
+
+    /* Make room, or write large requests directly. */
+
+    if (len > (int) (b->wend - b->wpos))
+    {
+        if (!fs_buf_drain(fh))
+            return 0;
+
+        if (len >= FS_BUF_SIZE)
+            return (n = fs_raw_write(data, len, fh)) > 0 ? n / size : n;
+
+        b->wend = b->data + FS_BUF_SIZE;
+    }
+
+    memcpy(b->wpos, data, len);
+    b->wpos += len;
+
+    return count;
+}
+
+int fs_flush(fs_file fh)
+{
+    if (FS_BUF(fh)->mem)
+        return 1;
+
+    fs_buf_drain(fh);
+    return fs_raw_flush(fh);
+}
+
+long fs_tell(fs_file fh)
+{
+    struct fs_buf *b = FS_BUF(fh);
+
+    if (b->mem)
+        return (long) (b->rpos - b->mem);
+
+    return fs_raw_tell(fh) - (long) (b->rend - b->rpos)
+                           + (long) (b->wpos - b->data);
+}
+
+/*
+ * Seek, returning non-zero on success.
+ */
+int fs_seek(fs_file fh, long offset, int whence)
+{
+    struct fs_buf *b = FS_BUF(fh);
+
+    if (b->mem)
+    {
+        long pos = offset;
+
+        if (whence == SEEK_CUR) pos += (long) (b->rpos - b->mem);
+        if (whence == SEEK_END) pos += (long) (b->rend - b->mem);
+
+        if (pos < 0 || pos > (long) (b->rend - b->mem))
+            return 0;
+
+        b->rpos = b->mem + pos;
+        return 1;
+    }
+
+    fs_buf_drain(fh);
+
+    /* Short relative seeks stay within the bytes read ahead. */
+
+    if (whence == SEEK_CUR)
+    {
+        if (offset >= (long) (b->data - b->rpos) &&
+            offset <= (long) (b->rend - b->rpos))
+        {
+            b->rpos += offset;
+            return 1;
+        }
+        offset -= (long) (b->rend - b->rpos);
+    }
+
+    b->rpos = b->rend = b->data;
+
+    return fs_raw_seek(fh, offset, whence);
+}
+
+int fs_eof(fs_file fh)
+{
+    struct fs_buf *b = FS_BUF(fh);
+
+    if (b->rpos < b->rend)
+        return 0;
+
+    return b->mem ? 1 : fs_raw_eof(fh);
+}
+
+int fs_length(fs_file fh)
+{
+    struct fs_buf *b = FS_BUF(fh);
+
+    if (b->mem)
+        return (int) (b->rend - b->mem);
+
+    fs_buf_drain(fh);
+    return fs_raw_length(fh);
+}
+
 int fs_getc(fs_file fh)
 {
+    struct fs_buf *b = FS_BUF(fh);
     unsigned char c;
 
+    if (b->rpos < b->rend)
+        return (int) *b->rpos++;
+
     if (fs_read(&c, 1, 1, fh) != 1)
         return -1;
 
@@ -99,12 +411,16 @@ int fs_getc(fs_file fh)
 
 int fs_putc(int c, fs_file fh)
 {
-    unsigned char b = (unsigned char) c;
+    struct fs_buf *b = FS_BUF(fh);
+    unsigned char u = (unsigned char) c;
+
+    if (b->wpos < b->wend)
+        return (int) (*b->wpos++ = u);
 
-    if (fs_write(&b, 1, 1, fh) != 1)
+    if (fs_write(&u, 1, 1, fh) != 1)
         return -1;
 
-    return b;
+    return u;
 }
 
 int fs_puts(const char *src, fs_file fh)
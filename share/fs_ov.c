@@ -22,7 +22,7 @@ size_t fs_ov_read(void *ptr, size_t size, size_t nmemb, void *datasource)
 
 int fs_ov_seek(void *datasource, ogg_int64_t offset, int whence)
 {
-    return fs_seek(datasource, offset, whence);
+    return fs_seek(datasource, offset, whence) ? 0 : -1;
 }
 
 int fs_ov_close(void *datasource)
@@ -19,6 +19,8 @@
 #include <unistd.h>
 
 #include "fs.h"
+#include "fs_buf.h"
+#include "fs_zip.h"
 #include "dir.h"
 #include "array.h"
 #include "common.h"
@@ -32,7 +34,8 @@
 
 struct fs_file_s
 {
-    PHYSFS_file *handle;
+    struct fs_buf buf;
+    PHYSFS_file  *handle;
 };
 
 int fs_init(const char *argv0)
@@ -53,6 +56,8 @@ int fs_init(const char *argv0)
 
 int fs_quit(void)
 {
+    fs_zip_quit();
+    fs_cache_clear();
     return PHYSFS_deinit();
 }
 
@@ -70,11 +75,19 @@ const char *fs_base_dir(void)
 
 int fs_add_path(const char *path)
 {
-    return PHYSFS_addToSearchPath(path, 0);
+    /* ZIP archives are mounted by fs_zip, the rest by PhysFS. */
+
+    fs_cache_clear();
+
+    if (fs_zip_is_archive(path))
+        return fs_zip_mount(path);
+
+    return PHYSFS_addToSearchPath(path, 0) && fs_zip_mount(path);
 }
 
 int fs_set_write_dir(const char *path)
 {
+    fs_cache_clear();
     return PHYSFS_setWriteDir(path);
 }
 
@@ -98,6 +111,8 @@ static List list_files(const char *path)
         PHYSFS_freeList(files);
     }
 
+    fs_zip_list(path, &list);
+
     return list;
 }
 
@@ -131,22 +146,37 @@ fs_file fs_open(const char *path, const char *mode)
 
     if ((fh = malloc(sizeof (*fh))))
     {
+        int rc;
+
+        fh->handle = NULL;
+
         switch (mode[0])
         {
         case 'r':
-            fh->handle = PHYSFS_openRead(path);
+            if (fs_cache_get(path) < 0)
+                break;
+
+            if ((rc = fs_zip_open(path, FS_BUF(fh))) > 0)
+                return fh;
+
+            if (rc == 0)
+                fh->handle = PHYSFS_openRead(path);
+
+            fs_cache_put(path, fh->handle ? 1 : -1);
             break;
 
         case 'w':
             fh->handle = (mode[1] == '+' ?
                           PHYSFS_openAppend(path) :
                           PHYSFS_openWrite(path));
+
+            fs_cache_put(path, 0);
             break;
         }
 
         if (fh->handle)
         {
-            PHYSFS_setBuffer(fh->handle, 0x2000);
+            fs_buf_init(fh);
         }
         else
         {
@@ -160,11 +190,22 @@ fs_file fs_open(const char *path, const char *mode)
 
 int fs_close(fs_file fh)
 {
-    if (PHYSFS_close(fh->handle))
+    int rc;
+
+    if (fh->buf.mem)
     {
+        free(fh->buf.mem);
         free(fh);
         return 1;
     }
+
+    rc = fs_buf_drain(fh);
+
+    if (PHYSFS_close(fh->handle))
+    {
+        free(fh);
+        return rc;
+    }
     return 0;
 }
 
@@ -172,42 +213,76 @@ int fs_close(fs_file fh)
 
 int fs_mkdir(const char *path)
 {
-    return PHYSFS_mkdir(path);
+    int rc = PHYSFS_mkdir(path);
+
+    fs_cache_put(path, 0);
+    return rc;
 }
 
 int fs_exists(const char *path)
 {
-    return PHYSFS_exists(path);
+    int rc;
+
+    if ((rc = fs_zip_exists(path)) || (rc = fs_cache_get(path)))
+        return rc > 0;
+
+    rc = PHYSFS_exists(path);
+    fs_cache_put(path, rc ? 1 : -1);
+    return rc;
 }
 
 int fs_remove(const char *path)
 {
-    return PHYSFS_delete(path);
+    int rc = PHYSFS_delete(path);
+
+    fs_cache_put(path, 0);
+    return rc;
+}
+
+/*
+ * Return the directory or archive that PATH is found in.
+ */
+const char *fs_real_dir(const char *path)
+{
+    const char *dir;
+
+    return (dir = fs_zip_real_dir(path)) ? dir : PHYSFS_getRealDir(path);
+}
+
+/*
+ * Return the modification time of PATH, or -1.
+ */
+long fs_mtime(const char *path)
+{
+    if (fs_zip_exists(path))
+        return fs_zip_mtime(path);
+
+    return (long) PHYSFS_getLastModTime(path);
 }
 
 /*---------------------------------------------------------------------------*/
 
-int fs_read(void *data, int size, int count, fs_file fh)
+int fs_raw_read(void *data, int size, fs_file fh)
 {
-    return PHYSFS_read(fh->handle, data, size, count);
+    return PHYSFS_read(fh->handle, data, 1, size);
 }
 
-int fs_write(const void *data, int size, int count, fs_file fh)
+int fs_raw_write(const void *data, int size, fs_file fh)
 {
-    return PHYSFS_write(fh->handle, data, size, count);
+    return PHYSFS_write(fh->handle, data, 1, size);
 }
 
-int fs_flush(fs_file fh)
+int fs_raw_flush(fs_file fh)
 {
     return PHYSFS_flush(fh->handle);
 }
 
-long fs_tell(fs_file fh)
+long fs_raw_tell(fs_file fh)
 {
     return PHYSFS_tell(fh->handle);
 }
 
-int fs_seek(fs_file fh, long offset, int whence)
+int fs_raw_seek(fs_file fh, long offset, int whence)
 {
     PHYSFS_uint64 pos = 0;
     PHYSFS_sint64 cur = PHYSFS_tell(fh->handle);
@@ -235,12 +310,12 @@ int fs_seek(fs_file fh, long offset, int whence)
     return PHYSFS_seek(fh->handle, pos);
 }
 
-int fs_eof(fs_file fh)
+int fs_raw_eof(fs_file fh)
 {
     return PHYSFS_eof(fh->handle);
 }
 
-int fs_length(fs_file fh)
+int fs_raw_length(fs_file fh)
 {
     return PHYSFS_fileLength(fh->handle);
 }
@@ -17,8 +17,11 @@
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 #include "fs.h"
+#include "fs_buf.h"
+#include "fs_zip.h"
 #include "dir.h"
 #include "array.h"
 #include "list.h"
@@ -33,7 +36,8 @@
 
 struct fs_file_s
 {
-    FILE *handle;
+    struct fs_buf buf;
+    FILE         *handle;
 };
 
 static char *fs_dir_base;
@@ -51,6 +55,9 @@ int fs_init(const char *argv0)
 
 int fs_quit(void)
 {
+    fs_zip_quit();
+    fs_cache_clear();
+
     if (fs_dir_base)
     {
         free(fs_dir_base);
@@ -86,12 +93,15 @@ const char *fs_base_dir(void)
 
 int fs_add_path(const char *path)
 {
-    /* TODO: ZIP archive support. */
+    fs_cache_clear();
+
+    if (fs_zip_is_archive(path))
+        return fs_zip_mount(path);
 
     if (dir_exists(path))
     {
         fs_path = list_cons(strdup(path), fs_path);
-        return 1;
+        return fs_zip_mount(path);
     }
     return 0;
 }
@@ -107,6 +117,7 @@ int fs_set_write_dir(const char *path)
         }
 
         fs_dir_write = strdup(path);
+        fs_cache_clear();
         return 1;
     }
     return 0;
@@ -172,6 +183,8 @@ static List list_files(const char *path)
         free(real);
     }
 
+    fs_zip_list(path, &files);
+
     return files;
 }
 
@@ -227,18 +240,26 @@ fs_file fs_open(const char *path, const char *mode)
     if ((fh = malloc(sizeof (*fh))))
     {
         char *real;
+        int rc;
 
         fh->handle = NULL;
 
         switch (mode[0])
         {
         case 'r':
-            if ((real = real_path(path)))
+            if (fs_cache_get(path) < 0)
+                break;
+
+            if ((rc = fs_zip_open(path, FS_BUF(fh))) > 0)
+                return fh;
+
+            if (rc == 0 && (real = real_path(path)))
             {
                 fh->handle = fopen(real, "rb");
                 free(real);
             }
 
+            fs_cache_put(path, fh->handle ? 1 : -1);
             break;
 
         case 'w':
@@ -251,11 +272,17 @@ fs_file fs_open(const char *path, const char *mode)
                               fopen(real, "wb+"));
 
                 free(real);
+
+                fs_cache_put(path, 0);
             }
             break;
         }
 
-        if (!fh->handle)
+        if (fh->handle)
+        {
+            fs_buf_init(fh);
+        }
+        else
         {
             free(fh);
             fh = NULL;
@@ -267,12 +294,20 @@ fs_file fs_open(const char *path, const char *mode)
 
 int fs_close(fs_file fh)
 {
-    if (fclose(fh->handle))
+    int rc;
+
+    if (fh->buf.mem)
     {
+        free(fh->buf.mem);
         free(fh);
         return 1;
     }
-    return 0;
+
+    rc = fs_buf_drain(fh);
+    rc = (fclose(fh->handle) == 0) && rc;
+    free(fh);
+
+    return rc;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -286,18 +321,26 @@ int fs_mkdir(const char *path)
     rc = dir_make(real);
     free((void *) real);
 
+    fs_cache_put(path, 0);
+
     return rc == 0;
 }
 
 int fs_exists(const char *path)
 {
     char *real;
+    int rc;
+
+    if ((rc = fs_zip_exists(path)) || (rc = fs_cache_get(path)))
+        return rc > 0;
 
     if ((real = real_path(path)))
     {
         free(real);
+        fs_cache_put(path, 1);
         return 1;
     }
+    fs_cache_put(path, -1);
     return 0;
 }
 
@@ -310,37 +353,85 @@ int fs_remove(const char *path)
     rc = (remove(real) == 0);
     free(real);
 
+    fs_cache_put(path, 0);
+
+    return rc;
+}
+
+/*
+ * Return the directory that PATH is found in.
+ */
+const char *fs_real_dir(const char *path)
+{
+    const char *dir;
+    List p;
+
+    if ((dir = fs_zip_real_dir(path)))
+        return dir;
+
+    for (p = fs_path; p; p = p->next)
+    {
+        char *real = path_join(p->data, path);
+        int   rc   = file_exists(real);
+
+        free(real);
+
+        if (rc)
+            return p->data;
+    }
+    return NULL;
+}
+
+/*
+ * Return the modification time of PATH, or -1.
+ */
+long fs_mtime(const char *path)
+{
+    struct stat buf;
+    char *real;
+    long rc = -1;
+
+    if (fs_zip_exists(path))
+        return fs_zip_mtime(path);
+
+    if ((real = real_path(path)))
+    {
+        if (stat(real, &buf) == 0)
+            rc = (long) buf.st_mtime;
+
+        free(real);
+    }
     return rc;
 }
 
 /*---------------------------------------------------------------------------*/
 
-int fs_read(void *data, int size, int count, fs_file fh)
+int fs_raw_read(void *data, int size, fs_file fh)
 {
-    return fread(data, size, count, fh->handle);
+    return fread(data, 1, size, fh->handle);
 }
 
-int fs_write(const void *data, int size, int count, fs_file fh)
+int fs_raw_write(const void *data, int size, fs_file fh)
 {
-    return fwrite(data, size, count, fh->handle);
+    return fwrite(data, 1, size, fh->handle);
 }
 
-int fs_flush(fs_file fh)
+int fs_raw_flush(fs_file fh)
 {
     return fflush(fh->handle);
 }
 
-long fs_tell(fs_file fh)
+long fs_raw_tell(fs_file fh)
 {
     return ftell(fh->handle);
 }
 
-int fs_seek(fs_file fh, long offset, int whence)
+int fs_raw_seek(fs_file fh, long offset, int whence)
 {
-    return fseek(fh->handle, offset, whence);
+    return (fseek(fh->handle, offset, whence) == 0);
 }
 
-int fs_eof(fs_file fh)
+int fs_raw_eof(fs_file fh)
 {
     /*
      * Unlike PhysicsFS, stdio does not register EOF unless we have
@@ -351,7 +442,7 @@ int fs_eof(fs_file fh)
     return feof(fh->handle);
 }
 
-int fs_length(fs_file fh)
+int fs_raw_length(fs_file fh)
 {
     long len, cur = ftell(fh->handle);
 
@@ -0,0 +1,827 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/* For pread, which -std=c99 leaves undeclared. */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "fs.h"
+#include "fs_zip.h"
+#include "dir.h"
+#include "hmap.h"
+#include "common.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define ZIP_STORED  0
+#define ZIP_DEFLATE 8
+#define ZIP_ABSENT  -1                  /* Known not to exist                */
+
+#define INDEX_DIR   "Cache/Zips"
+#define INDEX_MAGIC 0x325a424e          /* "NBZ2"                            */
+
+struct zip_entry
+{
+    unsigned int name;                  /* Offset into the name block        */
+    unsigned int offset;                /* Offset of the data in the archive */
+    unsigned int size;
+    unsigned int csize;
+    int          method;
+};
+
+struct zip_mount
+{
+    char *path;
+    int   dir;                          /* A directory, not an archive       */
+    long  mtime;
+    int   fd;
+
+    struct zip_entry *ents;
+    int               count;
+    char             *names;
+    unsigned int      names_len;
+};
+
+static struct zip_mount *mounts;
+static int               mount_count;
+
+/* Open-addressed table of mount + 1 and entry, by entry name. */
+
+struct zip_slot
+{
+    int m;
+    int e;
+};
+
+static struct zip_slot *table;
+static int              table_size;
+static int              table_used;
+
+/*---------------------------------------------------------------------------*/
+
+static const char *slot_name(const struct zip_slot *s)
+{
+    const struct zip_mount *m = mounts + s->m - 1;
+
+    return m->names + m->ents[s->e].name;
+}
+
+static void table_put(int m, int e);
+
+static int table_grow(void)
+{
+    struct zip_slot *old = table;
+    int n = table_size, i;
+
+    if (!(table = calloc(table_size = MAX(n * 2, 1024), sizeof (*table))))
+    {
+        table      = old;
+        table_size = n;
+        return 0;
+    }
+
+    table_used = 0;
+
+    for (i = 0; i < n; i++)
+        if (old[i].m)
+            table_put(old[i].m - 1, old[i].e);
+
+    free(old);
+    return 1;
+}
+
+/*
+ * Insert an entry, replacing any of the same name from earlier mounts.
+ */
+static void table_put(int m, int e)
+{
+    const char *name = mounts[m].names + mounts[m].ents[e].name;
+    unsigned int h;
+
+    if (2 * (table_used + 1) > table_size && !table_grow())
+        return;
+
+    h = hmap_hash(name) & (table_size - 1);
+
+    while (table[h].m && strcmp(slot_name(table + h), name))
+        h = (h + 1) & (table_size - 1);
+
+    if (!table[h].m)
+        table_used++;
+
+    table[h].m = m + 1;
+    table[h].e = e;
+}
+
+static const struct zip_slot *table_get(const char *name)
+{
+    unsigned int h;
+
+    if (!table_size)
+        return NULL;
+
+    h = hmap_hash(name) & (table_size - 1);
+
+    while (table[h].m)
+    {
+        if (strcmp(slot_name(table + h), name) == 0)
+            return table + h;
+
+        h = (h + 1) & (table_size - 1);
+    }
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int zip_read(const struct zip_mount *m, void *dst,
+                    unsigned int len, unsigned int off)
+{
+#ifdef _WIN32
+    FILE *fp;
+    int rc = 0;
+
+    if ((fp = fopen(m->path, "rb")))
+    {
+        rc = (fseek(fp, (long) off, SEEK_SET) == 0 &&
+              fread(dst, 1, len, fp) == len);
+        fclose(fp);
+    }
+    return rc;
+#else
+    unsigned int n = 0;
+    ssize_t r;
+
+    while (n < len && (r = pread(m->fd, (char *) dst + n, len - n,
+                                 (off_t) off + n)) > 0)
+        n += (unsigned int) r;
+
+    return n == len;
+#endif
+}
+
+static unsigned int get_u16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned int get_u32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+/*
+ * Read the central directory of an archive of the given size.
+ */
+static int zip_scan(struct zip_mount *m, unsigned int size)
+{
+    unsigned char *buf = NULL, *p;
+    unsigned int tail, cd_size, cd_off, count, i;
+    unsigned int names_cap = 0;
+    int rc = 0;
+
+    /* Find the end of central directory record. */
+
+    tail = MIN(size, 22 + 0xFFFF);
+
+    if (tail < 22 || !(buf = malloc(tail)) || !zip_read(m, buf, tail, size - tail))
+        goto done;
+
+    for (p = buf + tail - 22; p >= buf; p--)
+        if (get_u32(p) == 0x06054b50)
+            break;
+
+    if (p < buf)
+        goto done;
+
+    count   = get_u16(p + 10);
+    cd_size = get_u32(p + 12);
+    cd_off  = get_u32(p + 16);
+
+    free(buf);
+
+    if (cd_off > size || cd_size > size - cd_off || !(buf = malloc(cd_size)))
+    {
+        buf = NULL;
+        goto done;
+    }
+
+    if (!zip_read(m, buf, cd_size, cd_off))
+        goto done;
+
+    if (!(m->ents = calloc(MAX(count, 1), sizeof (*m->ents))))
+        goto done;
+
+    /* Walk the central directory entries. */
+
+    for (p = buf, i = 0; i < count && p + 46 <= buf + cd_size; i++)
+    {
+        unsigned int flags  = get_u16(p +  8);
+        unsigned int method = get_u16(p + 10);
+        unsigned int csize  = get_u32(p + 20);
+        unsigned int usize  = get_u32(p + 24);
+        unsigned int nlen   = get_u16(p + 28);
+        unsigned int xlen   = get_u16(p + 30);
+        unsigned int clen   = get_u16(p + 32);
+        unsigned int lho    = get_u32(p + 42);
+
+        const char *name = (const char *) p + 46;
+
+        if (get_u32(p) != 0x02014b50 || p + 46 + nlen > buf + cd_size)
+            break;
+
+        p += 46 + nlen + xlen + clen;
+
+        /* Skip directories, encrypted and unsupported entries. */
+
+        if (nlen == 0 || name[nlen - 1] == '/' || (flags & 1) ||
+            (method != ZIP_STORED && method != ZIP_DEFLATE))
+            continue;
+
+        if (m->names_len + nlen + 1 > names_cap)
+        {
+            char *names;
+
+            names_cap = MAX(names_cap * 2, m->names_len + nlen + 1);
+
+            if (!(names = realloc(m->names, names_cap)))
+                goto done;
+
+            m->names = names;
+        }
+
+        {
+            struct zip_entry *e = m->ents + m->count;
+            unsigned char loc[30];
+
+            /* Find the data past the local header. */
+
+            if (!zip_read(m, loc, sizeof (loc), lho) ||
+                get_u32(loc) != 0x04034b50)
+                continue;
+
+            e->name   = m->names_len;
+            e->offset = lho + 30 + get_u16(loc + 26) + get_u16(loc + 28);
+            e->size   = usize;
+            e->csize  = csize;
+            e->method = (int) method;
+
+            memcpy(m->names + m->names_len, name, nlen);
+            m->names[m->names_len + nlen] = 0;
+            m->names_len += nlen + 1;
+            m->count++;
+        }
+    }
+    rc = 1;
+
+done:
+    free(buf);
+    return rc;
+}
+
+/*
+ * Read the index at the head of a bundle.
+ */
+static int bundle_scan(struct zip_mount *m, unsigned int size)
+{
+    unsigned char head[16], *buf = NULL, *p;
+    unsigned int count, names_len, len, i;
+    int rc = 0;
+
+    if (!zip_read(m, head, sizeof (head), 0) || get_u32(head) != BUNDLE_MAGIC)
+        return 0;
+
+    count     = get_u32(head + 4);
+    names_len = get_u32(head + 8);
+
+    if (count > size / 16 || names_len > size)
+        return 0;
+
+    len = count * 16 + names_len;
+
+    if (!(buf = malloc(MAX(len, 1))) || !zip_read(m, buf, len, sizeof (head)))
+        goto done;
+
+    m->ents  = calloc(MAX(count, 1), sizeof (*m->ents));
+    m->names = malloc(names_len + 1);
+
+    if (!m->ents || !m->names)
+        goto done;
+
+    memcpy(m->names, buf + count * 16, names_len);
+    m->names[names_len] = 0;
+    m->names_len = names_len + 1;
+
+    for (p = buf, i = 0; i < count; i++, p += 16)
+    {
+        struct zip_entry *e = m->ents + m->count;
+
+        e->name   = get_u32(p);
+        e->offset = get_u32(p + 4);
+        e->size   = get_u32(p + 8);
+        e->csize  = e->size;
+        e->method = (get_u32(p + 12) & BUNDLE_ABSENT) ? ZIP_ABSENT : ZIP_STORED;
+
+        if (e->name < names_len && (e->method == ZIP_ABSENT ||
+                                    (e->offset <= size &&
+                                     e->size   <= size - e->offset)))
+            m->count++;
+    }
+    rc = 1;
+
+done:
+    free(buf);
+    return rc;
+}
+
+/*
+ * Check that a bundle is still current: that no file it holds has been
+ * changed next to it since it was built, and that no path it lists as
+ * missing has since appeared. A stale bundle would otherwise override
+ * the loose files.
+ */
+static int bundle_fresh(const struct zip_mount *m)
+{
+    char dir[MAXSTR];
+    struct stat buf;
+    int i, rc = 1;
+
+    SAFECPY(dir, dir_name(m->path));
+
+    for (i = 0; rc && i < m->count; i++)
+    {
+        const struct zip_entry *e = m->ents + i;
+        char *real;
+
+        if ((real = path_join(dir, m->names + e->name)))
+        {
+            if (stat(real, &buf) == 0)
+                rc = (e->method != ZIP_ABSENT &&
+                      (long) buf.st_mtime <= m->mtime);
+
+            free(real);
+        }
+    }
+    return rc;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static char *index_path(const char *path)
+{
+    const char *write_dir;
+    char name[MAXSTR];
+
+    if (!(write_dir = fs_get_write_dir()))
+        return NULL;
+
+    sprintf(name, INDEX_DIR "/%08x.idx", hmap_hash(path));
+
+    return path_join(write_dir, name);
+}
+
+/*
+ * Check that the entries of a loaded index name strings within its name
+ * block and data within the archive.
+ */
+static int index_check(const struct zip_mount *m, unsigned int size)
+{
+    int i;
+
+    if (m->names_len == 0 || m->names[m->names_len - 1] != 0)
+        return 0;
+
+    for (i = 0; i < m->count; i++)
+    {
+        const struct zip_entry *e = m->ents + i;
+
+        if (e->name >= m->names_len || e->offset > size ||
+            e->csize > size - e->offset ||
+            (e->method != ZIP_STORED && e->method != ZIP_DEFLATE))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Load the cached index of an archive, if it was made from this copy.
+ * Index names are only a hash of the path, so the path is stored too.
+ */
+static int index_load(struct zip_mount *m, long size)
+{
+    char *real;
+    FILE *fp;
+    int rc = 0;
+
+    if (!(real = index_path(m->path)))
+        return 0;
+
+    if ((fp = fopen(real, "rb")))
+    {
+        unsigned int magic = 0;
+        unsigned int path_len = 0;
+        long stamp[2];
+        int  count = 0;
+        unsigned int names_len = 0;
+        char path[MAXSTR];
+
+        if (fread(&magic,     sizeof (magic),     1, fp) == 1 &&
+            fread(&path_len,  sizeof (path_len),  1, fp) == 1 &&
+            magic == INDEX_MAGIC && path_len < sizeof (path) &&
+            fread(path, 1, path_len, fp) == path_len)
+            path[path_len] = 0;
+        else
+            path[0] = 0;
+
+        if (strcmp(path, m->path) == 0 &&
+            fread(stamp,      sizeof (stamp),     1, fp) == 1 &&
+            fread(&count,     sizeof (count),     1, fp) == 1 &&
+            fread(&names_len, sizeof (names_len), 1, fp) == 1 &&
+            stamp[0] == size && stamp[1] == m->mtime &&
+            count >= 0 && count <= size / 30 && names_len <= size)
+        {
+            m->ents  = calloc(MAX(count, 1), sizeof (*m->ents));
+            m->names = malloc(MAX(names_len, 1));
+
+            if (m->ents && m->names &&
+                fread(m->ents, sizeof (*m->ents), count, fp) == (size_t) count &&
+                fread(m->names, 1, names_len, fp) == names_len)
+            {
+                m->count     = count;
+                m->names_len = names_len;
+                rc = index_check(m, (unsigned int) size);
+            }
+
+            if (!rc)
+            {
+                free(m->ents);
+                free(m->names);
+
+                m->ents      = NULL;
+                m->names     = NULL;
+                m->count     = 0;
+                m->names_len = 0;
+            }
+        }
+        fclose(fp);
+    }
+    free(real);
+    return rc;
+}
+
+static void index_save(const struct zip_mount *m, long size)
+{
+    char *real;
+    FILE *fp;
+
+    if (!(real = index_path(m->path)))
+        return;
+
+    fs_mkdir("Cache");
+    fs_mkdir(INDEX_DIR);
+
+    if ((fp = fopen(real, "wb")))
+    {
+        unsigned int magic = INDEX_MAGIC;
+        unsigned int path_len = (unsigned int) strlen(m->path);
+        long stamp[2];
+
+        stamp[0] = size;
+        stamp[1] = m->mtime;
+
+        fwrite(&magic,        sizeof (magic),        1, fp);
+        fwrite(&path_len,     sizeof (path_len),     1, fp);
+        fwrite(m->path, 1, path_len, fp);
+        fwrite(stamp,         sizeof (stamp),        1, fp);
+        fwrite(&m->count,     sizeof (m->count),     1, fp);
+        fwrite(&m->names_len, sizeof (m->names_len), 1, fp);
+        fwrite(m->ents, sizeof (*m->ents), m->count, fp);
+        fwrite(m->names, 1, m->names_len, fp);
+
+        fclose(fp);
+    }
+    free(real);
+}
+
+/*---------------------------------------------------------------------------*/
+
+int fs_zip_is_archive(const char *path)
+{
+    return ((str_ends_with(path, ".zip") ||
+             str_ends_with(path, ".pk3") ||
+             str_ends_with(path, ".nbp")) && !dir_exists(path));
+}
+
+/*
+ * Note a mounted directory, or index and mount an archive.
+ */
+int fs_zip_mount(const char *path)
+{
+    struct zip_mount *m;
+    struct stat buf;
+    int e, ok;
+
+    if (!(m = realloc(mounts, (mount_count + 1) * sizeof (*m))))
+        return 0;
+
+    mounts = m;
+    m = mounts + mount_count;
+
+    memset(m, 0, sizeof (*m));
+
+    m->path = strdup(path);
+    m->fd   = -1;
+
+    if (!fs_zip_is_archive(path))
+    {
+        m->dir = 1;
+        mount_count++;
+        return 1;
+    }
+
+    if (stat(path, &buf) != 0)
+    {
+        free(m->path);
+        return 0;
+    }
+
+    m->mtime = (long) buf.st_mtime;
+
+#ifndef _WIN32
+    if ((m->fd = open(path, O_RDONLY)) < 0)
+    {
+        free(m->path);
+        return 0;
+    }
+#endif
+
+    /* Bundles carry their own index, archives get a cached one. */
+
+    if (str_ends_with(path, ".nbp"))
+        ok = bundle_scan(m, (unsigned int) buf.st_size) && bundle_fresh(m);
+
+    else if (!(ok = index_load(m, (long) buf.st_size)))
+    {
+        if ((ok = zip_scan(m, (unsigned int) buf.st_size)))
+            index_save(m, (long) buf.st_size);
+    }
+
+    if (!ok)
+    {
+        free(m->ents);
+        free(m->names);
+        free(m->path);
+#ifndef _WIN32
+        close(m->fd);
+#endif
+        return 0;
+    }
+
+    /* A bundle's missing paths do not hide those of earlier archives. */
+
+    for (e = 0; e < m->count; e++)
+        if (m->ents[e].method != ZIP_ABSENT || !table_get(m->names +
+                                                          m->ents[e].name))
+            table_put(mount_count, e);
+
+    mount_count++;
+
+    return 1;
+}
+
+void fs_zip_quit(void)
+{
+    int i;
+
+    for (i = 0; i < mount_count; i++)
+    {
+#ifndef _WIN32
+        if (mounts[i].fd >= 0)
+            close(mounts[i].fd);
+#endif
+        free(mounts[i].ents);
+        free(mounts[i].names);
+        free(mounts[i].path);
+    }
+
+    free(mounts);
+    free(table);
+
+    mounts      = NULL;
+    mount_count = 0;
+    table       = NULL;
+    table_size  = 0;
+    table_used  = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Find the entry for a path, unless a directory mounted later has it.
+ */
+static const struct zip_slot *zip_find(const char *path)
+{
+    const struct zip_slot *s;
+    int i;
+
+    if (!(s = table_get(path)))
+        return NULL;
+
+    for (i = s->m; i < mount_count; i++)
+        if (mounts[i].dir)
+        {
+            char *real = path_join(mounts[i].path, path);
+            int   rc   = file_exists(real);
+
+            free(real);
+
+            if (rc)
+                return NULL;
+        }
+
+    return s;
+}
+
+/*
+ * Read a whole entry into memory and serve the handle from there. Return
+ * 1 on success, -1 if a bundle lists the path as missing, 0 otherwise.
+ */
+int fs_zip_open(const char *path, struct fs_buf *b)
+{
+    const struct zip_slot *s;
+    const struct zip_mount *m;
+    const struct zip_entry *e;
+
+    unsigned char *p;
+
+    if (!(s = zip_find(path)))
+        return 0;
+
+    m = mounts + s->m - 1;
+    e = m->ents + s->e;
+
+    if (e->method == ZIP_ABSENT)
+        return -1;
+
+    if (!(p = malloc(MAX(e->size, 1))))
+        return 0;
+
+    if (e->method == ZIP_STORED)
+    {
+        if (e->csize != e->size || !zip_read(m, p, e->size, e->offset))
+        {
+            free(p);
+            return 0;
+        }
+    }
+    else
+    {
+        unsigned char *q;
+        z_stream z;
+        int rc = Z_DATA_ERROR;
+
+        if ((q = malloc(MAX(e->csize, 1))) && zip_read(m, q, e->csize, e->offset))
+        {
+            memset(&z, 0, sizeof (z));
+
+            if (inflateInit2(&z, -MAX_WBITS) == Z_OK)
+            {
+                z.next_in   = q;
+                z.avail_in  = e->csize;
+                z.next_out  = p;
+                z.avail_out = e->size;
+
+                rc = inflate(&z, Z_FINISH);
+
+                inflateEnd(&z);
+            }
+        }
+        free(q);
+
+        if (rc != Z_STREAM_END)
+        {
+            free(p);
+            return 0;
+        }
+    }
+
+    b->mem  = p;
+    b->rpos = p;
+    b->rend = p + e->size;
+    b->wpos = b->wend = b->data;
+
+    return 1;
+}
+
+static int slot_absent(const struct zip_slot *s)
+{
+    return mounts[s->m - 1].ents[s->e].method == ZIP_ABSENT;
+}
+
+/*
+ * Return 1 if the path is in an archive, -1 if a bundle lists it as
+ * missing, and 0 if it is up to the backend.
+ */
+int fs_zip_exists(const char *path)
+{
+    const struct zip_slot *s;
+
+    return (s = zip_find(path)) ? (slot_absent(s) ? -1 : 1) : 0;
+}
+
+const char *fs_zip_real_dir(const char *path)
+{
+    const struct zip_slot *s;
+
+    return ((s = zip_find(path)) && !slot_absent(s) ?
+            mounts[s->m - 1].path : NULL);
+}
+
+long fs_zip_mtime(const char *path)
+{
+    const struct zip_slot *s;
+
+    return ((s = zip_find(path)) && !slot_absent(s) ?
+            mounts[s->m - 1].mtime : -1);
+}
+
+/*
+ * Add the names of entries and implied directories just below PATH.
+ */
+void fs_zip_list(const char *path, List *items)
+{
+    size_t len = strlen(path);
+    int i, e;
+
+    for (i = 0; i < mount_count; i++)
+        for (e = 0; e < mounts[i].count; e++)
+        {
+            const char *name = mounts[i].names + mounts[i].ents[e].name;
+            const char *end;
+            List l;
+
+            if (mounts[i].ents[e].method == ZIP_ABSENT)
+                continue;
+
+            /* Match the parent directory. */
+
+            if (len)
+            {
+                if (strncmp(name, path, len) || name[len] != '/')
+                    continue;
+
+                name += len + 1;
+            }
+
+            end = strchr(name, '/');
+
+            if (!end)
+                end = name + strlen(name);
+
+            for (l = *items; l; l = l->next)
+                if (strncmp(l->data, name, end - name) == 0 &&
+                    ((const char *) l->data)[end - name] == 0)
+                    break;
+
+            if (!l)
+            {
+                char *item;
+
+                if ((item = malloc(end - name + 1)))
+                {
+                    memcpy(item, name, end - name);
+                    item[end - name] = 0;
+
+                    *items = list_cons(item, *items);
+                }
+            }
+        }
+}
+
+/*---------------------------------------------------------------------------*/
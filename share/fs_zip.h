@@ -0,0 +1,42 @@
+#ifndef FS_ZIP_H
+#define FS_ZIP_H
+
+#include "fs_buf.h"
+#include "list.h"
+
+/*
+ * ZIP archive mounting, shared by the file system backends. Each
+ * archive's directory is read once and kept as an index in the user
+ * directory. All mounted entries go into one hash table, and a file is
+ * read with a single positioned read, inflating it if compressed.
+ *
+ * Backends pass every path they mount through fs_zip_mount, in mount
+ * order. Directories are only noted, so that files in a directory take
+ * precedence over archives mounted earlier.
+ *
+ * Bundles (.nbp, written by packc) hold the files a level loads, in load
+ * order, each aligned to BUNDLE_ALIGN. They may also list paths known to
+ * be missing, so that probing for alternatives stays off the disk. All
+ * fields are 32-bit little-endian:
+ *
+ *     magic, count, names length, 0
+ *     count * (name offset, data offset, size, flags)
+ *     names, NUL-terminated
+ *     data
+ */
+
+#define BUNDLE_MAGIC  0x3150424e        /* "NBP1"                            */
+#define BUNDLE_ALIGN  4096
+#define BUNDLE_ABSENT 1                 /* Entry flag: path does not exist   */
+
+int  fs_zip_is_archive(const char *);
+int  fs_zip_mount(const char *);
+void fs_zip_quit(void);
+
+int         fs_zip_open(const char *, struct fs_buf *);
+int         fs_zip_exists(const char *);
+const char *fs_zip_real_dir(const char *);
+long        fs_zip_mtime(const char *);
+void        fs_zip_list(const char *, List *);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Time the ways the game reads files through the virtual file system:
+ * byte by byte, four-byte words as in SOL and replay loading, and lines
+ * as in set and score files. Build with ENABLE_FS=stdio and with the
+ * default PhysFS backend to compare the two.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "binary.h"
+#include "fs.h"
+#include "common.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define BENCH_PASSES 20
+
+static long bench_getc(fs_file fp)
+{
+    long n = 0;
+
+    while (fs_getc(fp) >= 0)
+        n++;
+
+    return n;
+}
+
+static long bench_index(fs_file fp)
+{
+    long n = 0;
+
+    while (!fs_eof(fp))
+    {
+        get_index(fp);
+        n += 4;
+    }
+    return n;
+}
+
+static long bench_gets(fs_file fp)
+{
+    char line[MAXSTR];
+    long n = 0;
+
+    while (fs_gets(line, sizeof (line), fp))
+        n += strlen(line);
+
+    return n;
+}
+
+static void bench(const char *path, const char *name, long (*fn)(fs_file))
+{
+    clock_t t0 = clock();
+    long    n  = 0;
+    int     i;
+
+    for (i = 0; i < BENCH_PASSES; i++)
+    {
+        fs_file fp;
+
+        if ((fp = fs_open(path, "r")))
+        {
+            n += fn(fp);
+            fs_close(fp);
+        }
+    }
+
+    {
+        double s = (double) (clock() - t0) / CLOCKS_PER_SEC;
+
+        printf("  %-6s %10ld bytes %8.2f ms %8.1f MB/s\n", name, n, s * 1000.0,
+               s > 0.0 ? n / s / (1024.0 * 1024.0) : 0.0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int argi;
+
+    if (!fs_init(argv[0]))
+    {
+        fprintf(stderr, "Failure to initialize virtual file system: %s\n",
+                fs_error());
+        return 1;
+    }
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s file.sol|file.nbr ...\n", argv[0]);
+        return 1;
+    }
+
+    for (argi = 1; argi < argc; argi++)
+    {
+        const char *path = argv[argi];
+
+        fs_add_path(dir_name(path));
+
+        printf("%s (%d passes)\n", base_name(path), BENCH_PASSES);
+
+        bench(base_name(path), "getc",  bench_getc);
+        bench(base_name(path), "index", bench_index);
+        bench(base_name(path), "gets",  bench_gets);
+    }
+
+    fs_quit();
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -136,6 +136,9 @@ int glext_init(void)
 
         gli.texture_cube_map = 1;
     }
+
+    if (glext_check("OES_compressed_ETC1_RGB8_texture"))
+        gli.texture_etc1 = 1;
 #else
 
     if (glext_assert("ARB_multitexture"))
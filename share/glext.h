@@ -192,6 +192,10 @@ int glext_init(void);
 #define GL_TEXTURE_GEN_STR_OES                                  0x8D60
 #endif
 
+#ifndef GL_OES_compressed_ETC1_RGB8_texture
+#define GL_ETC1_RGB8_OES                                        0x8D64
+#endif
+
 typedef void (APIENTRYP PFNGLTEXGENIOES_PROC)(GLenum coord, GLenum pname, GLint param);
 
 extern PFNGLTEXGENIOES_PROC glTexGeniOES_;
@@ -317,6 +321,7 @@ struct gl_info
     unsigned int shader_objects     : 1;
     unsigned int framebuffer_object : 1;
     unsigned int texture_cube_map : 1;
+    unsigned int texture_etc1       : 1;
 };
 
 extern struct gl_info gli;
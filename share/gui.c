@@ -21,11 +21,13 @@
 #include "video.h"
 #include "glext.h"
 #include "image.h"
+#include "thumb.h"
 #include "vec3.h"
 #include "gui.h"
 #include "common.h"
 #include "font.h"
 #include "theme.h"
+#include "prof.h"
 
 #include "fs.h"
 #include "fs_rwops.h"
@@ -64,6 +66,7 @@ const GLubyte gui_shd[4] = { 0x00, 0x00, 0x00, 0x80 };  /* Shadow */
 #define GUI_FILL   2
 #define GUI_HILITE 4
 #define GUI_RECT   8
+#define GUI_THUMB  16                   /* Image is a slot of the thumb atlas */
 
 #define GUI_LINES 8
 
@@ -88,6 +91,7 @@ struct widget
     int     cdr;
 
     GLuint  image;
+    GLfloat tex[4];                     /* Image texture rectangle           */
     GLfloat scale;
 
     int     text_w;
@@ -164,6 +168,17 @@ static struct vert vert_buf[WIDGET_MAX * WIDGET_VERT];
 static GLuint      vert_vbo = 0;
 static GLuint      vert_ebo = 0;
 
+/*
+ * Widget geometry is generated into vert_buf immediately but uploaded
+ * lazily.  The range of widgets touched since the last upload is kept
+ * here, and the whole span goes to the VBO in one call per frame.
+ */
+
+static int dirty_min = WIDGET_MAX;
+static int dirty_max = 0;
+
+static int upload_bytes = 0;
+
 /*---------------------------------------------------------------------------*/
 
 static void set_vert(struct vert *v, int x, int y,
@@ -181,6 +196,47 @@ static void set_vert(struct vert *v, int x, int y,
 
 /*---------------------------------------------------------------------------*/
 
+static void gui_dirty(int id)
+{
+    if (dirty_min > id) dirty_min = id;
+    if (dirty_max < id) dirty_max = id;
+}
+
+static void gui_flush(void)
+{
+    if (dirty_min <= dirty_max)
+    {
+        const GLintptr   o = dirty_min * WIDGET_VERT * sizeof (struct vert);
+        const GLsizeiptr n = (dirty_max - dirty_min + 1) *
+                             WIDGET_VERT * sizeof (struct vert);
+
+        glBindBuffer_   (GL_ARRAY_BUFFER, vert_vbo);
+        glBufferSubData_(GL_ARRAY_BUFFER, o, n, vert_buf + dirty_min *
+                                                           WIDGET_VERT);
+        glBindBuffer_   (GL_ARRAY_BUFFER, 0);
+
+        upload_bytes += (int) n;
+
+        dirty_min = WIDGET_MAX;
+        dirty_max = 0;
+    }
+}
+
+/*
+ * Return the number of vertex bytes sent to the GL since the previous
+ * call.  Called once per frame, this gives the per-frame upload size.
+ */
+int gui_upload_bytes(void)
+{
+    int n = upload_bytes;
+
+    upload_bytes = 0;
+
+    return n;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void draw_enable(GLboolean c, GLboolean u, GLboolean p)
 {
     glBindBuffer_(GL_ARRAY_BUFFER,         vert_vbo);
@@ -248,10 +304,27 @@ static const GLushort rect_elem_base[RECT_ELEM] = {
     2, 3, 6, 7, 10, 11, 14, 15          /* Bottom */
 };
 
-static void gui_geom_rect(int id, int x, int y, int w, int h, int f)
+static void gui_geom_elem(void)
 {
-    GLushort rect_elem[RECT_ELEM];
+    static GLushort elem_buf[WIDGET_MAX * WIDGET_ELEM];
+
+    int id, i;
+
+    /* Element data depends only on the widget index. Generate it once. */
+
+    for (id = 0; id < WIDGET_MAX; id++)
+        for (i = 0; i < RECT_ELEM; i++)
+            elem_buf[id * WIDGET_ELEM + i] = (GLushort)
+                (id * WIDGET_VERT + rect_elem_base[i]);
 
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, vert_ebo);
+    glBufferData_(GL_ELEMENT_ARRAY_BUFFER, sizeof (elem_buf), elem_buf,
+                  GL_STATIC_DRAW);
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+static void gui_geom_rect(int id, int x, int y, int w, int h, int f)
+{
     struct vert *v = vert_buf + id * WIDGET_VERT;
     struct vert *p = v;
 
@@ -276,22 +349,7 @@ static void gui_geom_rect(int id, int x, int y, int w, int h, int f)
         for (j = 0; j < 4; j++)
             set_vert(p++, X[i], Y[j], curr_theme.s[i], curr_theme.t[j], gui_wht);
 
-    for (i = 0; i < RECT_ELEM; i++)
-        rect_elem[i] = id * WIDGET_VERT + rect_elem_base[i];
-
-    /* Copy this off to the VBOs. */
-
-    glBindBuffer_   (GL_ARRAY_BUFFER, vert_vbo);
-    glBufferSubData_(GL_ARRAY_BUFFER,
-                     id * WIDGET_VERT * sizeof (struct vert),
-                            RECT_VERT * sizeof (struct vert), v);
-    glBindBuffer_   (GL_ARRAY_BUFFER, 0);
-
-    glBindBuffer_   (GL_ELEMENT_ARRAY_BUFFER, vert_ebo);
-    glBufferSubData_(GL_ELEMENT_ARRAY_BUFFER,
-                     id * WIDGET_ELEM * sizeof (GLushort),
-                            RECT_ELEM * sizeof (GLushort), rect_elem);
-    glBindBuffer_   (GL_ELEMENT_ARRAY_BUFFER, 0);
+    gui_dirty(id);
 }
 
 static void gui_geom_text(int id, int x, int y, int w, int h,
@@ -333,19 +391,15 @@ static void gui_geom_text(int id, int x, int y, int w, int h,
     }
     else memset(v, 0, TEXT_VERT * sizeof (struct vert));
 
-    /* Copy this off to the VBO. */
-
-    glBindBuffer_   (GL_ARRAY_BUFFER, vert_vbo);
-    glBufferSubData_(GL_ARRAY_BUFFER,
-                     (id * WIDGET_VERT + RECT_VERT) * sizeof (struct vert),
-                                         TEXT_VERT  * sizeof (struct vert), v);
-    glBindBuffer_   (GL_ARRAY_BUFFER, 0);
+    gui_dirty(id);
 }
 
 static void gui_geom_image(int id, int x, int y, int w, int h, int f)
 {
     struct vert *v = vert_buf + id * WIDGET_VERT + RECT_VERT;
 
+    const GLfloat *T = widget[id].tex;
+
     int X[2];
     int Y[2];
 
@@ -357,18 +411,12 @@ static void gui_geom_image(int id, int x, int y, int w, int h, int f)
     Y[0] = y + h - ((f & GUI_N) ? borders[2] : 0);
     Y[1] = y +     ((f & GUI_S) ? borders[3] : 0);
 
-    set_vert(v + 0, X[0], Y[0], 0.0f, 1.0f, gui_wht);
-    set_vert(v + 1, X[0], Y[1], 0.0f, 0.0f, gui_wht);
-    set_vert(v + 2, X[1], Y[0], 1.0f, 1.0f, gui_wht);
-    set_vert(v + 3, X[1], Y[1], 1.0f, 0.0f, gui_wht);
+    set_vert(v + 0, X[0], Y[0], T[0], T[3], gui_wht);
+    set_vert(v + 1, X[0], Y[1], T[0], T[1], gui_wht);
+    set_vert(v + 2, X[1], Y[0], T[2], T[3], gui_wht);
+    set_vert(v + 3, X[1], Y[1], T[2], T[1], gui_wht);
 
-    /* Copy this off to the VBO. */
-
-    glBindBuffer_   (GL_ARRAY_BUFFER, vert_vbo);
-    glBufferSubData_(GL_ARRAY_BUFFER,
-                     (id * WIDGET_VERT + RECT_VERT) * sizeof (struct vert),
-                     IMAGE_VERT * sizeof (struct vert), v);
-    glBindBuffer_   (GL_ARRAY_BUFFER, 0);
+    gui_dirty(id);
 }
 
 static void gui_geom_widget(int id, int flags)
@@ -532,12 +580,12 @@ void gui_init(void)
     glBufferData_(GL_ARRAY_BUFFER, sizeof (vert_buf), vert_buf, GL_STATIC_DRAW);
     glBindBuffer_(GL_ARRAY_BUFFER, 0);
 
-    glGenBuffers_(1,                      &vert_ebo);
-    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, vert_ebo);
-    glBufferData_(GL_ELEMENT_ARRAY_BUFFER,
-                  WIDGET_MAX * WIDGET_ELEM * sizeof (GLushort),
-                  NULL, GL_STATIC_DRAW);
-    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glGenBuffers_(1, &vert_ebo);
+
+    gui_geom_elem();
+
+    dirty_min = WIDGET_MAX;
+    dirty_max = 0;
 
     /* Cache digit glyphs for HUD rendering. */
 
@@ -582,7 +630,7 @@ void gui_free(void)
 
     for (id = 1; id < WIDGET_MAX; id++)
     {
-        if (widget[id].image)
+        if (widget[id].image && !(widget[id].flags & GUI_THUMB))
             glDeleteTextures(1, &widget[id].image);
 
         widget[id].type  = GUI_FREE;
@@ -596,7 +644,9 @@ void gui_free(void)
 
     gui_font_quit();
 
-    /* Release theme resources. */
+    /* Release the thumbnail atlas and theme resources. */
+
+    thumb_quit();
 
     gui_theme_quit();
 }
@@ -624,6 +674,10 @@ static int gui_widget(int pd, int type)
             widget[id].w      = 0;
             widget[id].h      = 0;
             widget[id].image  = 0;
+            widget[id].tex[0] = 0.0f;
+            widget[id].tex[1] = 0.0f;
+            widget[id].tex[2] = 1.0f;
+            widget[id].tex[3] = 1.0f;
             widget[id].color0 = gui_wht;
             widget[id].color1 = gui_wht;
             widget[id].scale  = 1.0f;
@@ -760,11 +814,65 @@ static char *gui_truncate(const char *text,
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Release the widget's image, which a thumbnail shares with others.
+ */
+static void gui_free_image(int id)
+{
+    if (widget[id].flags & GUI_THUMB)
+        widget[id].flags &= ~GUI_THUMB;
+    else
+        glDeleteTextures(1, &widget[id].image);
+
+    widget[id].image = 0;
+}
+
+/*
+ * Point the widget's image at TEX, redoing its geometry if the texture
+ * rectangle changes.
+ */
+static void gui_tex_image(int id, GLuint image, const GLfloat *tex)
+{
+    static const GLfloat full[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+    if (!tex)
+        tex = full;
+
+    widget[id].image = image;
+
+    if (memcmp(widget[id].tex, tex, sizeof (widget[id].tex)))
+    {
+        memcpy(widget[id].tex, tex, sizeof (widget[id].tex));
+
+        if (widget[id].type == GUI_IMAGE)
+            gui_geom_image(id, -widget[id].w / 2, -widget[id].h / 2,
+                           widget[id].w, widget[id].h, widget[id].rect);
+    }
+}
+
 void gui_set_image(int id, const char *file)
 {
-    glDeleteTextures(1, &widget[id].image);
+    gui_free_image(id);
+    gui_tex_image(id, make_image_from_file(file, IF_MIPMAP, 0), NULL);
+}
 
-    widget[id].image = make_image_from_file(file, IF_MIPMAP, 0);
+/*
+ * Show a down-sampled copy of the image from the thumbnail atlas.
+ */
+void gui_set_thumb(int id, const char *file)
+{
+    GLfloat tex[4];
+    GLuint  image;
+
+    gui_free_image(id);
+
+    if ((image = thumb_get(file, tex)))
+    {
+        widget[id].flags |= GUI_THUMB;
+        gui_tex_image(id, image, tex);
+    }
+    else
+        gui_tex_image(id, 0, NULL);
 }
 
 void gui_set_label(int id, const char *text)
@@ -776,7 +884,7 @@ void gui_set_label(int id, const char *text)
 
     char *str;
 
-    glDeleteTextures(1, &widget[id].image);
+    gui_free_image(id);
 
     str = gui_truncate(text, widget[id].w - padding, ttf, widget[id].trunc);
 
@@ -918,6 +1026,21 @@ int gui_image(int pd, const char *file, int w, int h)
     return id;
 }
 
+int gui_thumb(int pd, const char *file, int w, int h)
+{
+    int id;
+
+    if ((id = gui_widget(pd, GUI_IMAGE)))
+    {
+        widget[id].w      = w;
+        widget[id].h      = h;
+        widget[id].flags |= GUI_RECT;
+
+        gui_set_thumb(id, file);
+    }
+    return id;
+}
+
 int gui_start(int pd, const char *text, int size, int token, int value)
 {
     int id;
@@ -1432,7 +1555,7 @@ int gui_delete(int id)
 
         /* Release any GL resources held by this widget. */
 
-        if (widget[id].image)
+        if (widget[id].image && !(widget[id].flags & GUI_THUMB))
             glDeleteTextures(1, &widget[id].image);
 
         /* Mark this widget unused. */
@@ -1714,11 +1837,15 @@ void gui_paint(int id)
 {
     if (id)
     {
+        PROF_BEGIN("gui_paint");
+
         video_push_ortho();
         {
             glDisable(GL_LIGHTING);
             glDisable(GL_DEPTH_TEST);
             {
+                gui_flush();
+
                 draw_enable(GL_FALSE, GL_TRUE, GL_TRUE);
                 gui_paint_rect(id, 0, 0);
 
@@ -1735,6 +1862,8 @@ void gui_paint(int id)
             glEnable(GL_LIGHTING);
         }
         video_pop_matrix();
+
+        PROF_END();
     }
 }
 
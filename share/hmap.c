@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "hmap.h"
+#include "common.h"
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Open addressing with linear probing. Deleted slots keep a tombstone
+ * so that probe sequences running through them stay intact; they are
+ * reclaimed when the table is rebuilt.
+ */
+
+#define HMAP_MIN 16
+
+static char tomb[1];
+
+struct slot
+{
+    char *key;
+    int   val;
+};
+
+struct hmap
+{
+    struct slot *slots;
+
+    int size;                           /* Slot count, a power of two.  */
+    int used;                           /* Live keys.                   */
+    int fill;                           /* Live keys plus tombstones.   */
+};
+
+/*
+ * FNV-1a.
+ */
+unsigned int hmap_hash(const char *key)
+{
+    unsigned int h = 2166136261u;
+
+    while (*key)
+    {
+        h ^= (unsigned char) *key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static struct slot *hmap_find(Hmap m, const char *key)
+{
+    unsigned int i = hmap_hash(key) & (m->size - 1);
+
+    while (m->slots[i].key)
+    {
+        if (m->slots[i].key != tomb && strcmp(m->slots[i].key, key) == 0)
+            return &m->slots[i];
+
+        i = (i + 1) & (m->size - 1);
+    }
+    return NULL;
+}
+
+static void hmap_grow(Hmap m, int size)
+{
+    struct slot *old = m->slots;
+    int i, n = m->size;
+
+    if ((m->slots = calloc(size, sizeof (*m->slots))))
+    {
+        m->size = size;
+        m->fill = m->used;
+
+        for (i = 0; i < n; i++)
+            if (old[i].key && old[i].key != tomb)
+            {
+                unsigned int j = hmap_hash(old[i].key) & (size - 1);
+
+                while (m->slots[j].key)
+                    j = (j + 1) & (size - 1);
+
+                m->slots[j] = old[i];
+            }
+
+        free(old);
+    }
+    else m->slots = old;
+}
+
+/*----------------------------------------------------------------------------*/
+
+Hmap hmap_new(void)
+{
+    Hmap m;
+
+    if ((m = calloc(1, sizeof (*m))))
+    {
+        if ((m->slots = calloc(HMAP_MIN, sizeof (*m->slots))))
+            m->size = HMAP_MIN;
+        else
+        {
+            free(m);
+            m = NULL;
+        }
+    }
+    return m;
+}
+
+void hmap_clear(Hmap m)
+{
+    int i;
+
+    assert(m);
+
+    for (i = 0; i < m->size; i++)
+    {
+        if (m->slots[i].key != tomb)
+            free(m->slots[i].key);
+
+        m->slots[i].key = NULL;
+    }
+
+    m->used = 0;
+    m->fill = 0;
+}
+
+void hmap_free(Hmap m)
+{
+    if (m)
+    {
+        hmap_clear(m);
+        free(m->slots);
+        free(m);
+    }
+}
+
+/*
+ * Return the value stored under KEY, or DEF if there is none.
+ */
+int hmap_get(Hmap m, const char *key, int def)
+{
+    struct slot *s;
+
+    assert(m);
+
+    return (s = hmap_find(m, key)) ? s->val : def;
+}
+
+void hmap_put(Hmap m, const char *key, int val)
+{
+    struct slot *s;
+
+    assert(m);
+
+    if ((s = hmap_find(m, key)))
+    {
+        s->val = val;
+        return;
+    }
+
+    /* Keep the load factor under 3/4, counting tombstones. */
+
+    if ((m->fill + 1) * 4 > m->size * 3)
+        hmap_grow(m, m->used * 2 >= m->size ? m->size * 2 : m->size);
+
+    if ((m->fill + 1) * 4 <= m->size * 3)
+    {
+        unsigned int i = hmap_hash(key) & (m->size - 1);
+
+        char *k;
+
+        while (m->slots[i].key && m->slots[i].key != tomb)
+            i = (i + 1) & (m->size - 1);
+
+        if ((k = strdup(key)))
+        {
+            /* Reusing a tombstone does not change the fill count. */
+
+            if (m->slots[i].key == NULL)
+                m->fill++;
+
+            m->slots[i].key = k;
+            m->slots[i].val = val;
+
+            m->used++;
+        }
+    }
+}
+
+void hmap_del(Hmap m, const char *key)
+{
+    struct slot *s;
+
+    assert(m);
+
+    if ((s = hmap_find(m, key)))
+    {
+        free(s->key);
+        s->key = tomb;
+        m->used--;
+    }
+}
+
+int hmap_len(Hmap m)
+{
+    assert(m);
+
+    return m->used;
+}
+
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef HMAP_H
+#define HMAP_H
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * String-keyed hash map of integer values. Keys are copied.
+ */
+
+typedef struct hmap *Hmap;
+
+Hmap hmap_new(void);
+void hmap_free(Hmap);
+void hmap_clear(Hmap);
+
+int  hmap_get(Hmap, const char *, int);
+void hmap_put(Hmap, const char *, int);
+void hmap_del(Hmap, const char *);
+int  hmap_len(Hmap);
+
+unsigned int hmap_hash(const char *);
+
+/*----------------------------------------------------------------------------*/
+
+#endif
@@ -22,8 +22,12 @@
 #include "glext.h"
 #include "image.h"
 #include "base_image.h"
+#include "ntx.h"
 #include "config.h"
 #include "video.h"
+#include "common.h"
+#include "log.h"
+#include "loadtime.h"
 
 #include "fs.h"
 #include "fs_png.h"
@@ -99,47 +103,62 @@ void image_snap(const char *filename)
 
 /*---------------------------------------------------------------------------*/
 
-/*
- * Create an OpenGL texture object using the given image buffer.
- */
-GLuint make_texture(const void *p, int w, int h, int b, int fl, int env)
+static int image_is_ntx(const char *filename)
 {
-    static const GLenum format[] =
-        { 0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
-
-    GLuint o = 0;
+    size_t n = strlen(filename);
 
-    /* Scale the image as configured, or to fit the OpenGL limitations. */
+    return n > 4 && strcmp(filename + n - 4, ".ntx") == 0;
+}
 
-#ifdef GL_TEXTURE_MAX_ANISOTROPY_EXT
-    int a = config_get_d(CONFIG_ANISO);
-#endif
-#ifdef GL_GENERATE_MIPMAP_SGIS
-    int m = (fl & IF_MIPMAP) ? config_get_d(CONFIG_MIPMAP) : 0;
-#endif
+/*
+ * Compute the down-sampling factor for an image of the given size, as
+ * configured or as needed to fit the OpenGL limitations.
+ */
+static int texture_scale(int w, int h)
+{
     int k = config_get_d(CONFIG_TEXTURES);
-    int W = w;
-    int H = h;
 
     GLint max = gli.max_texture_size;
 
-    void *q = NULL;
-
     while (w / k > (int) max || h / k > (int) max)
         k *= 2;
 
-    if (k > 1)
-        q = image_scale(p, w, h, b, &W, &H, k);
+    return k;
+}
 
-    /* Generate and configure a new OpenGL texture. */
+/*
+ * Return true if a texture with the given environment flag is a cube map.
+ */
+static int is_cube_map(int env)
+{
+#if ENABLE_OPENGLES
+    return gli.texture_cube_map && env;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Bind and configure the given OpenGL texture object for an image with
+ * the given number of stored levels. Return the texture target.
+ */
+static GLenum init_texture(GLuint o, int fl, int env, int levels)
+{
+#ifdef GL_TEXTURE_MAX_ANISOTROPY_EXT
+    int a = config_get_d(CONFIG_ANISO);
+#endif
+    int m = (fl & IF_MIPMAP) ? config_get_d(CONFIG_MIPMAP) : 0;
 
-    glGenTextures(1, &o);
     GLenum target = GL_TEXTURE_2D;
+
+#ifndef GL_GENERATE_MIPMAP_SGIS
+    if (levels == 1)
+        m = 0;
+#endif
+
 #if ENABLE_OPENGLES
-    if (gli.texture_cube_map && env) {
+    if (is_cube_map(env))
         target = GL_TEXTURE_CUBE_MAP_OES;
-        glBindTexture(GL_TEXTURE_CUBE_MAP_OES, o);
-    } else
 #endif
     glBindTexture(target, o);
 
@@ -149,36 +168,145 @@ GLuint make_texture(const void *p, int w, int h, int b, int fl, int env)
     glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-#ifdef GL_GENERATE_MIPMAP_SGIS
     if (m)
     {
-        glTexParameteri(target, GL_GENERATE_MIPMAP_SGIS, GL_TRUE);
+#ifdef GL_GENERATE_MIPMAP_SGIS
+        glTexParameteri(target, GL_GENERATE_MIPMAP_SGIS,
+                        levels == 1 ? GL_TRUE : GL_FALSE);
+#endif
         glTexParameteri(target, GL_TEXTURE_MIN_FILTER,
                         GL_LINEAR_MIPMAP_LINEAR);
     }
-#endif
 #ifdef GL_TEXTURE_MAX_ANISOTROPY_EXT
     if (a) glTexParameteri(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, a);
 #endif
 
+    return target;
+}
+
+/*
+ * Specify the image of the given OpenGL texture object.
+ */
+static void load_texture(GLuint o, const void *p, int W, int H, int b,
+                         int fl, int env)
+{
+    static const GLenum format[] =
+        { 0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+
+    /* Configure the OpenGL texture. */
+
+    init_texture(o, fl, env, 1);
+
     /* Copy the image to an OpenGL texture. */
 
 #if ENABLE_OPENGLES
     if (gli.texture_cube_map && env) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, q ? q : p);
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, q ? q : p);
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, q ? q : p);
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, q ? q : p);
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, q ? q : p);
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, q ? q : p);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, p);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, p);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, p);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, p);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, p);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z_OES, 0, format[b], W, H, 0, format[b], GL_UNSIGNED_BYTE, p);
     } else
 #endif
     glTexImage2D(GL_TEXTURE_2D, 0,
                  format[b], W, H, 0,
-                 format[b], GL_UNSIGNED_BYTE, q ? q : p);
+                 format[b], GL_UNSIGNED_BYTE, p);
+}
 
-    if (q) free(q);
+/*
+ * Specify the image of the given OpenGL texture object from the mip
+ * chain of an NTX container. Levels above the configured texture scale
+ * are skipped rather than resampled. ETC1 levels go to the GL as is if
+ * it supports them and are decoded on the CPU otherwise.
+ */
+static void load_ntx(GLuint o, const struct ntx *t, int fl, int env)
+{
+    static const GLenum format[] =
+        { 0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
 
+    int m = (fl & IF_MIPMAP) ? config_get_d(CONFIG_MIPMAP) : 0;
+    int k = texture_scale(t->lv[0].w, t->lv[0].h);
+    int s = 0, i, n;
+
+    while (k > 1 && s < t->c - 1)
+    {
+        k /= 2;
+        s++;
+    }
+
+    /* Cube maps take the single image path. */
+
+    if (env)
+    {
+        void *p;
+
+        if ((p = ntx_decode(t, s)))
+        {
+            load_texture(o, p, t->lv[s].w, t->lv[s].h, t->b, fl, env);
+            free(p);
+        }
+        return;
+    }
+
+    n = m ? t->c - s : 1;
+
+    init_texture(o, fl, env, n);
+
+    for (i = 0; i < n; i++)
+    {
+        const struct ntx_level *l = t->lv + s + i;
+
+        if (t->fmt == NTX_ETC1)
+        {
+            void *p;
+
+#if ENABLE_OPENGLES
+            if (gli.texture_etc1)
+            {
+                glCompressedTexImage2D(GL_TEXTURE_2D, i, GL_ETC1_RGB8_OES,
+                                       l->w, l->h, 0, l->n, l->p);
+                continue;
+            }
+#endif
+            if ((p = ntx_decode(t, s + i)))
+            {
+                glTexImage2D(GL_TEXTURE_2D, i, GL_RGB, l->w, l->h, 0,
+                             GL_RGB, GL_UNSIGNED_BYTE, p);
+                free(p);
+            }
+        }
+        else
+            glTexImage2D(GL_TEXTURE_2D, i, format[t->b], l->w, l->h, 0,
+                         format[t->b], GL_UNSIGNED_BYTE, l->p);
+    }
+}
+
+/*
+ * Create an OpenGL texture object using the given image buffer.
+ */
+GLuint make_texture(const void *p, int w, int h, int b, int fl, int env)
+{
+    GLuint o = 0;
+
+    /* Scale the image as configured, or to fit the OpenGL limitations. */
+
+    int k = texture_scale(w, h);
+    int W = w;
+    int H = h;
+
+    void *q = NULL;
+
+    if (k > 1)
+        q = image_scale(p, w, h, b, &W, &H, k);
+
+    /* Generate a new OpenGL texture and copy the image to it. */
+
+    glGenTextures(1, &o);
+
+    load_texture(o, q ? q : p, W, H, b, fl, env);
+
+    if (q) free(q);
 
     return o;
 }
@@ -194,6 +322,21 @@ GLuint make_image_from_file(const char *filename, int fl, int env)
     int    b;
     GLuint o = 0;
 
+    /* Load a texture container. */
+
+    if (image_is_ntx(filename))
+    {
+        struct ntx t;
+
+        if (ntx_read(&t, filename))
+        {
+            glGenTextures(1, &o);
+            load_ntx(o, &t, fl, env);
+            ntx_free(&t);
+        }
+        return o;
+    }
+
     /* Load the image. */
 
     if ((p = image_load(filename, &w, &h, &b)))
@@ -207,6 +350,365 @@ GLuint make_image_from_file(const char *filename, int fl, int env)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Background image loading.
+ *
+ * Images are read, decoded and down-sampled by worker threads into CPU
+ * buffers. The OpenGL texture object is created immediately, holding a
+ * single white texel until image_sync uploads the decoded image from
+ * the GL thread. A job names several candidate paths, of which the
+ * first that loads is used. If none do, the placeholder remains.
+ */
+
+#define LOADER_MAX 4
+
+enum
+{
+    JOB_TODO,
+    JOB_BUSY,
+    JOB_DONE
+};
+
+struct image_job
+{
+    struct image_job *next;
+
+    char   path[IMAGE_PATHS][MAXSTR];
+    int    n;
+
+    GLuint o;
+    int    fl;
+    int    env;
+    int    k;
+
+    int    state;
+    int    cancel;
+
+    void  *p;
+    int    w;
+    int    h;
+    int    b;
+
+    struct ntx t;
+
+    float  ms;                          /* Time to read and decode           */
+};
+
+static SDL_Thread *loader_threads[LOADER_MAX];
+static int         loader_count;
+static int         loader_stop;
+
+static SDL_mutex  *loader_mutex;
+static SDL_cond   *loader_cond;
+
+static struct image_job *jobs_head;
+static struct image_job *jobs_tail;
+
+static void load_job(struct image_job *job)
+{
+    Uint64 t0 = SDL_GetPerformanceCounter();
+    int i;
+
+    for (i = 0; i < job->n && !job->p; i++)
+    {
+        if (image_is_ntx(job->path[i]))
+        {
+            if (ntx_read(&job->t, job->path[i]))
+                break;
+        }
+        else
+            job->p = image_load(job->path[i], &job->w, &job->h, &job->b);
+    }
+
+    if (job->p)
+    {
+        int k = job->k;
+
+        while (job->w / k > (int) gli.max_texture_size ||
+               job->h / k > (int) gli.max_texture_size)
+            k *= 2;
+
+        if (k > 1)
+        {
+            void *q;
+
+            if ((q = image_scale(job->p, job->w, job->h, job->b,
+                                 &job->w, &job->h, k)))
+            {
+                free(job->p);
+                job->p = q;
+            }
+        }
+    }
+
+    job->ms = (float) ((SDL_GetPerformanceCounter() - t0) * 1000.0 /
+                       SDL_GetPerformanceFrequency());
+}
+
+static int loader_func(void *data)
+{
+    struct image_job *job;
+
+    SDL_LockMutex(loader_mutex);
+
+    while (!loader_stop)
+    {
+        /* Take the oldest waiting job, if any. */
+
+        for (job = jobs_head; job; job = job->next)
+            if (job->state == JOB_TODO)
+                break;
+
+        if (job)
+        {
+            int cancel = job->cancel;
+
+            job->state = JOB_BUSY;
+
+            SDL_UnlockMutex(loader_mutex);
+            {
+                if (!cancel)
+                    load_job(job);
+            }
+            SDL_LockMutex(loader_mutex);
+
+            job->state = JOB_DONE;
+        }
+        else SDL_CondWait(loader_cond, loader_mutex);
+    }
+
+    SDL_UnlockMutex(loader_mutex);
+
+    return 0;
+}
+
+void image_init(void)
+{
+    int i, n = SDL_GetCPUCount() - 1;
+
+    image_quit();
+
+    n = CLAMP(1, n, LOADER_MAX);
+
+    if ((loader_mutex = SDL_CreateMutex()) &&
+        (loader_cond  = SDL_CreateCond()))
+    {
+        loader_stop = 0;
+
+        for (i = 0; i < n; i++)
+            if ((loader_threads[loader_count] =
+                 SDL_CreateThread(loader_func, "image", NULL)))
+                loader_count++;
+    }
+
+    if (loader_count == 0)
+        log_printf("Failure to start image loaders (%s)\n", SDL_GetError());
+}
+
+void image_quit(void)
+{
+    struct image_job *job;
+    int i;
+
+    if (loader_mutex)
+    {
+        SDL_LockMutex(loader_mutex);
+        loader_stop = 1;
+        SDL_CondBroadcast(loader_cond);
+        SDL_UnlockMutex(loader_mutex);
+
+        for (i = 0; i < loader_count; i++)
+            SDL_WaitThread(loader_threads[i], NULL);
+
+        loader_count = 0;
+
+        while ((job = jobs_head))
+        {
+            jobs_head = job->next;
+            ntx_free(&job->t);
+            free(job->p);
+            free(job);
+        }
+        jobs_tail = NULL;
+
+        if (loader_cond)
+            SDL_DestroyCond(loader_cond);
+
+        SDL_DestroyMutex(loader_mutex);
+
+        loader_cond  = NULL;
+        loader_mutex = NULL;
+    }
+}
+
+/*
+ * Create a placeholder texture and queue the first loadable image of
+ * the given paths for upload to it. Without loader threads, the image
+ * is loaded in place.
+ */
+GLuint make_image_async(const char **paths, int n, int fl, int env)
+{
+    static const GLubyte white[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+
+    struct image_job *job;
+
+    GLuint o = 0;
+    int i;
+
+    if (loader_count == 0 || !(job = calloc(1, sizeof (*job))))
+    {
+        for (i = 0; i < n; i++)
+            if ((o = make_image_from_file(paths[i], fl, env)))
+                break;
+
+        return o;
+    }
+
+    for (i = 0; i < n && i < IMAGE_PATHS; i++)
+        SAFECPY(job->path[i], paths[i]);
+
+    glGenTextures(1, &o);
+
+    load_texture(o, white, 1, 1, 4, fl, env);
+
+    job->n   = i;
+    job->o   = o;
+    job->fl  = fl;
+    job->env = env;
+    job->k   = config_get_d(CONFIG_TEXTURES);
+
+    SDL_LockMutex(loader_mutex);
+    {
+        if (jobs_tail)
+            jobs_tail->next = job;
+        else
+            jobs_head = job;
+
+        jobs_tail = job;
+
+        SDL_CondSignal(loader_cond);
+    }
+    SDL_UnlockMutex(loader_mutex);
+
+    return o;
+}
+
+/*
+ * Drop any pending upload to the given texture object. This must be
+ * called before the object is deleted.
+ */
+void image_cancel(GLuint o)
+{
+    struct image_job *job;
+
+    if (loader_mutex && o)
+    {
+        SDL_LockMutex(loader_mutex);
+        {
+            for (job = jobs_head; job; job = job->next)
+                if (job->o == o)
+                    job->cancel = 1;
+        }
+        SDL_UnlockMutex(loader_mutex);
+    }
+}
+
+/*
+ * Upload all decoded images. If WAIT is set, block until no jobs are
+ * pending. Return the number of jobs still pending.
+ */
+int image_sync(int wait)
+{
+    struct image_job *done = NULL, *job, **link;
+    int pending = 0;
+
+    if (!loader_mutex)
+        return 0;
+
+    do
+    {
+        SDL_LockMutex(loader_mutex);
+        {
+            /* Unlink finished jobs. */
+
+            pending   = 0;
+            jobs_tail = NULL;
+
+            for (link = &jobs_head; (job = *link); )
+                if (job->state == JOB_DONE)
+                {
+                    *link = job->next;
+                    job->next = done;
+                    done = job;
+                }
+                else
+                {
+                    jobs_tail = job;
+                    link = &job->next;
+                    pending++;
+                }
+        }
+        SDL_UnlockMutex(loader_mutex);
+
+        /* Upload them. */
+
+        while ((job = done))
+        {
+            done = job->next;
+
+            if ((job->p || job->t.c) && !job->cancel)
+            {
+                Uint64 t0 = SDL_GetPerformanceCounter();
+                GLint o = 0, ws = 0, wt = 0;
+
+                /* Preserve the current binding. */
+
+                glGetIntegerv(GL_TEXTURE_BINDING_2D, &o);
+
+                /* Keep the wrap modes mtrl set on the placeholder. */
+
+                if (!is_cube_map(job->env))
+                {
+                    glBindTexture(GL_TEXTURE_2D, job->o);
+                    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &ws);
+                    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &wt);
+                }
+
+                if (job->t.c)
+                    load_ntx(job->o, &job->t, job->fl, job->env);
+                else
+                    load_texture(job->o, job->p, job->w, job->h, job->b,
+                                 job->fl, job->env);
+
+                if (!is_cube_map(job->env))
+                {
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, ws);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wt);
+                }
+
+                glBindTexture(GL_TEXTURE_2D, (GLuint) o);
+
+                loadtime_add("tex_load", job->ms);
+                loadtime_add("tex_upload",
+                             (float) ((SDL_GetPerformanceCounter() - t0) *
+                                      1000.0 / SDL_GetPerformanceFrequency()));
+            }
+
+            ntx_free(&job->t);
+            free(job->p);
+            free(job);
+        }
+
+        if (wait && pending)
+            SDL_Delay(1);
+    }
+    while (wait && pending);
+
+    return pending;
+}
+
+/*---------------------------------------------------------------------------*/
+
 /*
  * Render the given  string using the given font.   Transfer the image
  * to a  surface of  power-of-2 size large  enough to fit  the string.
@@ -11,6 +11,8 @@
 
 #define IF_MIPMAP 0x01
 
+#define IMAGE_PATHS 8
+
 #if SDL_BYTEORDER == SDL_BIG_ENDIAN
 #define RMASK 0xFF000000
 #define GMASK 0x00FF0000
@@ -30,6 +32,12 @@ GLuint make_image_from_font(int *, int *,
                             int *, int *, const char *, TTF_Font *, int);
 GLuint make_texture(const void *, int, int, int, int, int);
 
+void   image_init(void);
+void   image_quit(void);
+GLuint make_image_async(const char **, int, int, int);
+void   image_cancel(GLuint);
+int    image_sync(int);
+
 SDL_Surface *load_surface(const char *);
 
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Check the image scale, whiten and flip kernels against the original
+ * per-component loops, kept here as the reference, and time both. Every
+ * image under png/ in the given data directory is run through each
+ * kernel; any output that differs from the reference by a single byte
+ * is reported and fails the run. Run as
+ *
+ *     imgbench <data> [image]...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "base_image.h"
+#include "fs.h"
+#include "common.h"
+
+/*---------------------------------------------------------------------------*/
+
+/* Reference kernels, as they were before the row-wise rewrite. */
+
+static void *ref_scale(const void *p, int w, int h, int b, int *wn, int *hn,
+                       int n)
+{
+    unsigned char *src = (unsigned char *) p;
+    unsigned char *dst = NULL;
+
+    int W = w / n;
+    int H = h / n;
+
+    if ((dst = (unsigned char *) calloc(W * H * b, sizeof (unsigned char))))
+    {
+        int si, di;
+        int sj, dj;
+        int i;
+
+        for (di = 0; di < H; di++)
+            for (dj = 0; dj < W; dj++)
+                for (i = 0; i < b; i++)
+                {
+                    int c = 0;
+
+                    for (si = di * n; si < (di + 1) * n; si++)
+                        for (sj = dj * n; sj < (dj + 1) * n; sj++)
+                            c += src[(si * w + sj) * b + i];
+
+                    dst[(di * W + dj) * b + i] =
+                        (unsigned char) (c / (n * n));
+                }
+
+        if (wn) *wn = W;
+        if (hn) *hn = H;
+    }
+
+    return dst;
+}
+
+static void ref_white(void *p, int w, int h, int b)
+{
+    unsigned char *s = (unsigned char *) p;
+
+    int i;
+
+    if (b == 1 || b == 3)
+    {
+        memset(s, 0xFF, w * h * b);
+    }
+    else if (b == 2)
+    {
+        for (i = 0; i < w * h * b; i += 2)
+            s[i] = 0xFF;
+    }
+    else
+    {
+        for (i = 0; i < w * h * b; i += 4)
+        {
+            s[i + 0] = 0xFF;
+            s[i + 1] = 0xFF;
+            s[i + 2] = 0xFF;
+        }
+    }
+}
+
+static void *ref_flip(const void *p, int w, int h, int b, int hflip, int vflip)
+{
+    unsigned char *q;
+
+    if ((q = malloc(w * b * h)))
+    {
+        int r, c, i;
+
+        for (r = 0; r < h; r++)
+            for (c = 0; c < w; c++)
+                for (i = 0; i < b; i++)
+                {
+                    int pr = vflip ? h - r - 1 : r;
+                    int pc = hflip ? w - c - 1 : c;
+
+                    int qi = r  * w * b + c  * b + i;
+                    int pi = pr * w * b + pc * b + i;
+
+                    q[qi] = ((const unsigned char *) p)[pi];
+                }
+        return q;
+    }
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+enum
+{
+    K_SCALE2,
+    K_SCALE3,
+    K_SCALE4,
+    K_WHITE,
+    K_HFLIP,
+    K_VFLIP,
+    K_HVFLIP,
+
+    K_MAX
+};
+
+static const char *kernel_names[K_MAX] = {
+    "scale 2",
+    "scale 3",
+    "scale 4",
+    "white",
+    "flip h",
+    "flip v",
+    "flip hv"
+};
+
+static struct
+{
+    double ref;
+    double cur;
+    int    runs;
+    int    fails;
+} totals[K_MAX];
+
+static double seconds_since(clock_t t0)
+{
+    return (double) (clock() - t0) / CLOCKS_PER_SEC;
+}
+
+/*
+ * Run kernel K over an image with both implementations and compare.
+ */
+static void run(int k, const char *name, const void *p, int w, int h, int b)
+{
+    unsigned char *r = NULL;
+    unsigned char *c = NULL;
+    int rw = w, rh = h, cw = w, ch = h;
+    clock_t t0;
+
+    if (k <= K_SCALE4)
+    {
+        int n = k - K_SCALE2 + 2;
+
+        if (w < n || h < n)
+            return;
+
+        t0 = clock();
+        r = ref_scale(p, w, h, b, &rw, &rh, n);
+        totals[k].ref += seconds_since(t0);
+
+        t0 = clock();
+        c = image_scale(p, w, h, b, &cw, &ch, n);
+        totals[k].cur += seconds_since(t0);
+    }
+    else if (k == K_WHITE)
+    {
+        if ((r = malloc(w * h * b)) && (c = malloc(w * h * b)))
+        {
+            memcpy(r, p, w * h * b);
+            memcpy(c, p, w * h * b);
+
+            t0 = clock();
+            ref_white(r, w, h, b);
+            totals[k].ref += seconds_since(t0);
+
+            t0 = clock();
+            image_white(c, w, h, b);
+            totals[k].cur += seconds_since(t0);
+        }
+    }
+    else
+    {
+        int hflip = (k == K_HFLIP || k == K_HVFLIP);
+        int vflip = (k == K_VFLIP || k == K_HVFLIP);
+
+        t0 = clock();
+        r = ref_flip(p, w, h, b, hflip, vflip);
+        totals[k].ref += seconds_since(t0);
+
+        t0 = clock();
+        c = image_flip(p, w, h, b, hflip, vflip);
+        totals[k].cur += seconds_since(t0);
+    }
+
+    totals[k].runs++;
+
+    if (!r || !c || rw != cw || rh != ch || memcmp(r, c, rw * rh * b) != 0)
+    {
+        fprintf(stderr, "%s: %s output differs\n", name, kernel_names[k]);
+        totals[k].fails++;
+    }
+
+    free(r);
+    free(c);
+}
+
+static int bench(const char *path)
+{
+    void *p;
+    int w, h, b, k;
+
+    if (!(p = image_load(path, &w, &h, &b)))
+    {
+        fprintf(stderr, "Failure to load %s\n", path);
+        return 0;
+    }
+
+    for (k = 0; k < K_MAX; k++)
+        run(k, path, p, w, h, b);
+
+    free(p);
+    return 1;
+}
+
+static int is_image(struct dir_item *item)
+{
+    return str_ends_with(item->path, ".png") || str_ends_with(item->path, ".jpg");
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    int argi, k, count = 0, fails = 0;
+
+    if (!fs_init(argv[0]))
+    {
+        fprintf(stderr, "Failure to initialize virtual file system: %s\n",
+                fs_error());
+        return 1;
+    }
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <data> [image]...\n", argv[0]);
+        return 1;
+    }
+
+    fs_add_path(argv[1]);
+
+    if (argc > 2)
+    {
+        for (argi = 2; argi < argc; argi++)
+            count += bench(argv[argi]);
+    }
+    else
+    {
+        Array items;
+        int i;
+
+        if ((items = fs_dir_scan("png", is_image)))
+        {
+            for (i = 0; i < array_len(items); i++)
+                count += bench(DIR_ITEM_GET(items, i)->path);
+
+            fs_dir_free(items);
+        }
+    }
+
+    printf("%d images\n", count);
+    printf("  %-8s %10s %10s %8s %6s\n", "kernel", "ref_ms", "new_ms",
+           "speedup", "fails");
+
+    for (k = 0; k < K_MAX; k++)
+    {
+        printf("  %-8s %10.2f %10.2f %7.1fx %6d\n", kernel_names[k],
+               totals[k].ref * 1000.0, totals[k].cur * 1000.0,
+               totals[k].cur > 0.0 ? totals[k].ref / totals[k].cur : 0.0,
+               totals[k].fails);
+
+        fails += totals[k].fails;
+    }
+
+    fs_quit();
+
+    return (fails || count == 0) ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------------*/
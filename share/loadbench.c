@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Time the loading of levels without a display. Each level goes through
+ * the same steps as in the game, up to where OpenGL takes over: the SOL
+ * is read and its varying state set up, its textures and those of the
+ * background are found, read and decoded. Each level is logged as one
+ * load event, as the game does, for scripts/load-summary.sh. Run as
+ *
+ *     loadbench <data> <level.sol>... 2> load.txt
+ *
+ * with level paths relative to the data directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "solid_base.h"
+#include "solid_vary.h"
+#include "base_image.h"
+#include "ntx.h"
+#include "fs.h"
+#include "log.h"
+#include "loadtime.h"
+#include "common.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Find, read and decode a texture as the image loader does.
+ */
+static void load_texture(const char *name)
+{
+    char path[MAXSTR];
+    int i;
+
+    loadtime_enter("tex_load");
+
+    for (i = 0; i < ARRAYSIZE(tex_paths); i++)
+    {
+        CONCAT_PATH(path, &tex_paths[i], name);
+
+        if (str_ends_with(path, ".ntx"))
+        {
+            struct ntx t;
+
+            if (ntx_read(&t, path))
+            {
+                ntx_free(&t);
+                break;
+            }
+        }
+        else
+        {
+            void *p;
+            int w, h, b;
+
+            if ((p = image_load(path, &w, &h, &b)))
+            {
+                free(p);
+                break;
+            }
+        }
+    }
+
+    loadtime_leave();
+}
+
+static int load_sol(const char *path, struct s_base *base)
+{
+    int i;
+
+    if (!sol_load_base(base, path))
+        return 0;
+
+    for (i = 0; i < base->mc; i++)
+        if (base->mv[i].f[0])
+            load_texture(base->mv[i].f);
+
+    return 1;
+}
+
+static int load_level(const char *path)
+{
+    struct s_base base, back;
+    struct s_vary vary;
+    const char *back_name = "";
+    const char *grad_name = "";
+    int i, ok = 0;
+
+    loadtime_begin(path);
+
+    loadtime_enter("game_base_load");
+    ok = sol_load_base(&base, path);
+    loadtime_leave();
+
+    if (ok)
+    {
+        loadtime_enter("sol_load_vary");
+
+        if ((ok = sol_load_vary(&vary, &base)))
+            sol_free_vary(&vary);
+
+        loadtime_leave();
+    }
+
+    if (ok)
+    {
+        loadtime_enter("mtrl_cache_sol");
+
+        for (i = 0; i < base.mc; i++)
+            if (base.mv[i].f[0])
+                load_texture(base.mv[i].f);
+
+        loadtime_leave();
+
+        for (i = 0; i < base.dc; i++)
+        {
+            const char *k = base.av + base.dv[i].ai;
+            const char *v = base.av + base.dv[i].aj;
+
+            if (strcmp(k, "back") == 0) back_name = v;
+            if (strcmp(k, "grad") == 0) grad_name = v;
+        }
+
+        loadtime_enter("back_init");
+        {
+            void *p;
+            int w, h, b;
+
+            if (load_sol("geom/back/back.sol", &back))
+                sol_free_base(&back);
+
+            if ((p = image_load(grad_name, &w, &h, &b)))
+                free(p);
+
+            if (load_sol(back_name, &back))
+                sol_free_base(&back);
+        }
+        loadtime_leave();
+
+        sol_free_base(&base);
+    }
+
+    loadtime_end();
+
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    int argi, ret = 0;
+
+    if (!fs_init(argv[0]))
+    {
+        fprintf(stderr, "Failure to initialize virtual file system: %s\n",
+                fs_error());
+        return 1;
+    }
+
+    if (argc > 2)
+    {
+        fs_add_path_with_archives(argv[1]);
+
+        for (argi = 2; argi < argc; argi++)
+            if (!load_level(argv[argi]))
+            {
+                fprintf(stderr, "Failure to load %s\n", argv[argi]);
+                ret = 1;
+            }
+    }
+    else
+    {
+        fprintf(stderr, "Usage: %s <data> <level.sol>...\n", argv[0]);
+        ret = 1;
+    }
+
+    fs_quit();
+
+    return ret;
+}
+
+/*---------------------------------------------------------------------------*/
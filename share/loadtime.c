@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "loadtime.h"
+#include "common.h"
+#include "log.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define STAGE_MAX 16
+#define DEPTH_MAX 8
+
+#define LOAD_TIMEOUT 10000.0f           /* Give up waiting on images, in ms  */
+
+static struct
+{
+    const char *name;
+    float       ms;
+    int         n;
+} stages[STAGE_MAX];
+
+static int stage_count;
+
+static int    depth;
+static int    open_stage[DEPTH_MAX];
+static Uint64 open_t0[DEPTH_MAX];
+
+static int    active;
+static char   level[MAXSTR];
+static Uint64 begin_t0;
+static float  first_frame;
+
+static float ms_since(Uint64 t0)
+{
+    return (float) ((SDL_GetPerformanceCounter() - t0) * 1000.0 /
+                    SDL_GetPerformanceFrequency());
+}
+
+/*
+ * Find a stage by name. Names are string literals, compared by address
+ * first.
+ */
+static int stage_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < stage_count; i++)
+        if (stages[i].name == name || strcmp(stages[i].name, name) == 0)
+            return i;
+
+    if (stage_count < STAGE_MAX)
+    {
+        stages[stage_count].name = name;
+        stages[stage_count].ms   = 0.0f;
+        stages[stage_count].n    = 0;
+        return stage_count++;
+    }
+    return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void loadtime_begin(const char *path)
+{
+    SAFECPY(level, path);
+
+    stage_count = 0;
+    depth       = 0;
+    first_frame = 0.0f;
+    begin_t0    = SDL_GetPerformanceCounter();
+    active      = 1;
+}
+
+void loadtime_enter(const char *stage)
+{
+    if (active)
+    {
+        if (depth < DEPTH_MAX)
+        {
+            open_stage[depth] = stage_find(stage);
+            open_t0   [depth] = SDL_GetPerformanceCounter();
+        }
+        depth++;
+    }
+}
+
+void loadtime_leave(void)
+{
+    if (active && depth > 0)
+    {
+        if (--depth < DEPTH_MAX && open_stage[depth] >= 0)
+        {
+            stages[open_stage[depth]].ms += ms_since(open_t0[depth]);
+            stages[open_stage[depth]].n  += 1;
+        }
+    }
+}
+
+/*
+ * Add a time measured elsewhere, such as on an image loader thread.
+ */
+void loadtime_add(const char *stage, float ms)
+{
+    int i;
+
+    if (active && (i = stage_find(stage)) >= 0)
+    {
+        stages[i].ms += ms;
+        stages[i].n  += 1;
+    }
+}
+
+/*
+ * Finish the transition and write it to the log.
+ */
+void loadtime_end(void)
+{
+    char line[MAXSTR * 4];
+    int  len, i;
+
+    if (!active)
+        return;
+
+    len = sprintf(line, "{\"event\":\"load\",\"level\":\"%s\"", level);
+
+    if (first_frame > 0.0f)
+        len += sprintf(line + len, ",\"first_frame_ms\":%.3f", first_frame);
+
+    len += sprintf(line + len, ",\"total_ms\":%.3f,\"stages\":{",
+                   ms_since(begin_t0));
+
+    for (i = 0; i < stage_count; i++)
+        len += sprintf(line + len, "%s\"%s\":[%.3f,%d]", i ? "," : "",
+                       stages[i].name, stages[i].ms, stages[i].n);
+
+    log_printf("%s}}\n", line);
+
+    active = 0;
+}
+
+/*
+ * Note a rendered frame, with the given number of images still loading.
+ */
+void loadtime_frame(int pending)
+{
+    if (active)
+    {
+        float ms = ms_since(begin_t0);
+
+        if (first_frame == 0.0f)
+            first_frame = ms;
+
+        if (pending == 0 || ms > LOAD_TIMEOUT)
+            loadtime_end();
+    }
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,30 @@
+#ifndef LOADTIME_H
+#define LOADTIME_H
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Level load timing. A transition runs from loadtime_begin until the
+ * first frame after which no images remain to be loaded, and its stages
+ * are timed by loadtime_enter and loadtime_leave, which nest. On
+ * completion one JSON line is written to the log:
+ *
+ *     {"event":"load","level":"...","first_frame_ms":...,"total_ms":...,
+ *      "stages":{"name":[ms,count],...}}
+ *
+ * Stage times are inclusive of nested stages. Outside of a transition
+ * all of these do nothing.
+ */
+
+void loadtime_begin(const char *level);
+void loadtime_end(void);
+
+void loadtime_enter(const char *stage);
+void loadtime_leave(void);
+void loadtime_add(const char *stage, float ms);
+
+void loadtime_frame(int pending);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
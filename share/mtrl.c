@@ -17,6 +17,7 @@
 
 #include "mtrl.h"
 #include "array.h"
+#include "hmap.h"
 #include "common.h"
 #include "image.h"
 #include "lang.h"
@@ -47,6 +48,7 @@
  */
 
 static Array mtrls;
+static Hmap  mtrl_keys;
 
 static struct b_mtrl default_base_mtrl =
 {
@@ -66,37 +68,175 @@ int default_mtrl;
  */
 static int find_mtrl(const char *name)
 {
-    int i, c = array_len(mtrls);
+    return mtrl_keys ? hmap_get(mtrl_keys, name, -1) : -1;
+}
 
-    for (i = 0; i < c; i++)
-    {
-        struct mtrl *mp = array_get(mtrls, i);
+/*---------------------------------------------------------------------------*/
 
-        if (mp->refc > 0 && strcmp(name, mp->base.f) == 0)
-            return i;
-    }
-    return -1;
-}
+/*
+ * Texture cache.
+ *
+ * Texture objects are shared by all materials that use the same image
+ * with the same upload and wrap flags, independently of the material
+ * cache. Textures that are no longer referenced are kept around for a
+ * while, so that a level change that reuses them does no decoding.
+ */
+
+#define TEX_FLAGS (M_ENVIRONMENT | M_CLAMP_S | M_CLAMP_T)
+
+#define TEX_SPARE 32                    /* Unreferenced textures kept */
+
+struct tex
+{
+    char         key[MAXSTR];
+    GLuint       o;
+    unsigned int refc;
+    unsigned int time;                  /* Time of release            */
+};
+
+static Array        texs;
+static Hmap         tex_keys;
+static unsigned int tex_time;
 
 /*
  * Load a material texture.
  */
 static GLuint find_texture(const char *name, int env)
 {
-    char path[MAXSTR];
-    GLuint o;
+    char path[ARRAYSIZE(tex_paths)][MAXSTR];
+    const char *paths[ARRAYSIZE(tex_paths)];
     int i;
 
     for (i = 0; i < ARRAYSIZE(tex_paths); i++)
     {
-        CONCAT_PATH(path, &tex_paths[i], name);
+        CONCAT_PATH(path[i], &tex_paths[i], name);
+        paths[i] = path[i];
+    }
+
+    return make_image_async(paths, i, IF_MIPMAP, env);
+}
+
+/*
+ * Delete least recently released textures until at most N remain.
+ */
+static void tex_trim(int n)
+{
+    int i, c, spare;
+
+    if (!texs)
+        return;
+
+    c = array_len(texs);
+
+    do
+    {
+        struct tex *oldest = NULL;
+
+        for (spare = 0, i = 0; i < c; i++)
+        {
+            struct tex *tp = array_get(texs, i);
 
-        if ((o = make_image_from_file(path, IF_MIPMAP, env)))
-            return o;
+            if (tp->o && tp->refc == 0)
+            {
+                if (!oldest || tp->time < oldest->time)
+                    oldest = tp;
+
+                spare++;
+            }
+        }
+
+        if (spare > n && oldest)
+        {
+            image_cancel(oldest->o);
+            glDeleteTextures(1, &oldest->o);
+            hmap_del(tex_keys, oldest->key);
+
+            oldest->o = 0;
+            spare--;
+        }
     }
-    return 0;
+    while (spare > n);
 }
 
+/*
+ * Obtain a texture ref for the given image name and material flags.
+ */
+static int tex_cache(const char *name, int fl)
+{
+    struct tex *tp;
+    char key[MAXSTR];
+    GLuint o;
+    int i, c;
+
+    fl &= TEX_FLAGS;
+
+    snprintf(key, sizeof (key), "%x:%s", fl, name);
+
+    if ((i = hmap_get(tex_keys, key, -1)) >= 0)
+    {
+        tp = array_get(texs, i);
+        tp->refc++;
+        return i;
+    }
+
+    /* Load the texture. */
+
+    if (!(o = find_texture(name, fl & M_ENVIRONMENT)))
+        return -1;
+
+    /* Set the texture to clamp or repeat based on material type. */
+
+    if (fl & M_CLAMP_S)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    else
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+
+    if (fl & M_CLAMP_T)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    else
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    /* Find an empty slot or allocate a new one. */
+
+    for (c = array_len(texs), i = 0; i < c; i++)
+        if (((struct tex *) array_get(texs, i))->o == 0)
+            break;
+
+    if (i == c && !array_add(texs))
+    {
+        glDeleteTextures(1, &o);
+        return -1;
+    }
+
+    tp = array_get(texs, i);
+
+    SAFECPY(tp->key, key);
+
+    tp->o    = o;
+    tp->refc = 1;
+    tp->time = 0;
+
+    hmap_put(tex_keys, tp->key, i);
+
+    return i;
+}
+
+/*
+ * Release a texture ref.
+ */
+static void tex_free(int i)
+{
+    struct tex *tp = array_get(texs, i);
+
+    if (tp->refc > 0 && --tp->refc == 0)
+    {
+        tp->time = ++tex_time;
+        tex_trim(TEX_SPARE);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 /*
  * Load GL resources of an initialized material.
  */
@@ -109,20 +249,8 @@ static void load_mtrl_objects(struct mtrl *mp)
 
     /* Load the texture. */
 
-    if ((mp->o = find_texture(_(mp->base.f), mp->base.fl & M_ENVIRONMENT)))
-    {
-        /* Set the texture to clamp or repeat based on material type. */
-
-        if (mp->base.fl & M_CLAMP_S)
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        else
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-
-        if (mp->base.fl & M_CLAMP_T)
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        else
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    }
+    if ((mp->t = tex_cache(_(mp->base.f), mp->base.fl)) >= 0)
+        mp->o = ((struct tex *) array_get(texs, mp->t))->o;
 }
 
 /*
@@ -132,34 +260,42 @@ static void free_mtrl_objects(struct mtrl *mp)
 {
     if (mp->o)
     {
-        glDeleteTextures(1, &mp->o);
+        tex_free(mp->t);
 
         mp->o = 0;
     }
 }
 
 /*
- * Load a material from a base material.
+ * Load a material from the base material it holds.
  */
-static void load_mtrl(struct mtrl *mp, const struct b_mtrl *base)
+static void load_mtrl_values(struct mtrl *mp)
 {
-    /* Copy the base material. */
-
-    memcpy(&mp->base, base, sizeof (struct b_mtrl));
-
     /* Cache the 32-bit material values for quick comparison. */
 
-    mp->d = touint(base->d);
-    mp->a = touint(base->a);
-    mp->s = touint(base->s);
-    mp->e = touint(base->e);
-    mp->h = tobyte(base->h[0]);
+    mp->d = touint(mp->base.d);
+    mp->a = touint(mp->base.a);
+    mp->s = touint(mp->base.s);
+    mp->e = touint(mp->base.e);
+    mp->h = tobyte(mp->base.h[0]);
 
     /* Load GL resources. */
 
     load_mtrl_objects(mp);
 }
 
+/*
+ * Load a material from a base material.
+ */
+static void load_mtrl(struct mtrl *mp, const struct b_mtrl *base)
+{
+    /* Copy the base material. */
+
+    memcpy(&mp->base, base, sizeof (struct b_mtrl));
+
+    load_mtrl_values(mp);
+}
+
 /*
  * Free a material.
  */
@@ -191,6 +327,7 @@ int mtrl_cache(const struct b_mtrl *base)
             {
                 load_mtrl(mp, base);
                 mp->refc++;
+                hmap_put(mtrl_keys, mp->base.f, i);
                 return i;
             }
         }
@@ -202,7 +339,8 @@ int mtrl_cache(const struct b_mtrl *base)
             memset(mp, 0, sizeof (*mp));
             load_mtrl(mp, base);
             mp->refc++;
-            return array_len(mtrls) - 1;
+            hmap_put(mtrl_keys, mp->base.f, c);
+            return c;
         }
     }
     else
@@ -228,7 +366,10 @@ void mtrl_free(int mi)
             mp->refc--;
 
             if (mp->refc == 0)
+            {
+                hmap_del(mtrl_keys, mp->base.f);
                 free_mtrl(mp);
+            }
         }
     }
 }
@@ -290,6 +431,10 @@ void mtrl_reload(void)
 
         int i, c = array_len(mtrls);
 
+        /* Release textures first so that the images are read anew. */
+
+        mtrl_free_objects();
+
         for (i = 0; i < c; i++)
         {
             struct mtrl *mp = array_get(mtrls, i);
@@ -297,10 +442,15 @@ void mtrl_reload(void)
             /* Read the material specification. */
 
             if (mp->refc > 0 && mtrl_read(&base, mp->base.f))
-            {
-                free_mtrl(mp);
-                load_mtrl(mp, &base);
-            }
+                memcpy(&mp->base, &base, sizeof (struct b_mtrl));
+        }
+
+        for (i = 0; i < c; i++)
+        {
+            struct mtrl *mp = array_get(mtrls, i);
+
+            if (mp->refc > 0)
+                load_mtrl_values(mp);
         }
     }
 }
@@ -335,6 +485,10 @@ void mtrl_free_objects(void)
         if (mp->refc > 0)
             free_mtrl_objects(mp);
     }
+
+    /* Textures may be invalid after this, e.g. on video mode changes. */
+
+    tex_trim(0);
 }
 
 /*
@@ -344,6 +498,11 @@ void mtrl_init(void)
 {
     mtrl_quit();
 
+    texs     = array_new(sizeof (struct tex));
+    tex_keys = hmap_new();
+
+    mtrl_keys = hmap_new();
+
     if ((mtrls = array_new(sizeof (struct mtrl))))
     {
         /* Cache the default material at index 0. */
@@ -367,6 +526,26 @@ void mtrl_quit(void)
         array_free(mtrls);
         mtrls = NULL;
     }
+
+    if (mtrl_keys)
+    {
+        hmap_free(mtrl_keys);
+        mtrl_keys = NULL;
+    }
+
+    if (texs)
+    {
+        tex_trim(0);
+
+        array_free(texs);
+        texs = NULL;
+    }
+
+    if (tex_keys)
+    {
+        hmap_free(tex_keys);
+        tex_keys = NULL;
+    }
 }
 /*---------------------------------------------------------------------------*/
 
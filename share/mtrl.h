@@ -23,6 +23,7 @@ struct mtrl
     GLuint e;                              /* 32-bit emissive color cache    */
     GLuint h;                              /* 32-bit specular exponent cache */
     GLuint o;                              /* OpenGL texture object          */
+    int    t;                              /* Texture cache index            */
 
     unsigned int refc;
 };
@@ -0,0 +1,488 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "ntx.h"
+#include "binary.h"
+#include "common.h"
+#include "fs.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * File layout, all integers little-endian:
+ *
+ *     magic, version, format, bytes per pixel, level count
+ *     per level: width, height, size, data
+ *
+ * Pixel rows are stored bottom-up, as returned by image_load and as
+ * expected by glTexImage2D. ETC1 levels are 4x4 blocks in the same row
+ * order, ready for glCompressedTexImage2D.
+ */
+
+#define NTX_MAGIC   (0x0058544E)        /* "NTX\0" */
+#define NTX_VERSION 1
+
+/*---------------------------------------------------------------------------*/
+
+static const int etc1_mod[8][4] = {
+    {  2,   8,  -2,   -8 },
+    {  5,  17,  -5,  -17 },
+    {  9,  29,  -9,  -29 },
+    { 13,  42, -13,  -42 },
+    { 18,  60, -18,  -60 },
+    { 24,  80, -24,  -80 },
+    { 33, 106, -33, -106 },
+    { 47, 183, -47, -183 }
+};
+
+static int etc1_size(int w, int h)
+{
+    return ((w + 3) / 4) * ((h + 3) / 4) * 8;
+}
+
+static unsigned char clamp_byte(int c)
+{
+    return (unsigned char) (c < 0 ? 0 : (c > 255 ? 255 : c));
+}
+
+/*
+ * Choose the best codeword and modifiers for one half of a block, given
+ * its 4-bit base color. Return the squared error.
+ */
+static int etc1_half(const unsigned char px[8][3], const int base[3],
+                     int *cw, int idx[8])
+{
+    int best = INT_MAX, t, i, j, k;
+
+    for (t = 0; t < 8; t++)
+    {
+        int err = 0, sel[8];
+
+        for (i = 0; i < 8 && err < best; i++)
+        {
+            int min = INT_MAX;
+
+            for (j = 0; j < 4; j++)
+            {
+                int e = 0;
+
+                for (k = 0; k < 3; k++)
+                {
+                    int d = clamp_byte(base[k] * 17 + etc1_mod[t][j]) - px[i][k];
+                    e += d * d;
+                }
+
+                if (e < min)
+                {
+                    min = e;
+                    sel[i] = j;
+                }
+            }
+            err += min;
+        }
+
+        if (err < best)
+        {
+            best = err;
+           *cw   = t;
+
+            memcpy(idx, sel, sizeof (sel));
+        }
+    }
+    return best;
+}
+
+/*
+ * Encode one 4x4 RGB block in ETC1 individual mode.
+ */
+static void etc1_block(unsigned char *dst, const unsigned char blk[4][4][3])
+{
+    unsigned int best_hi = 0, best_lo = 0;
+    int best = INT_MAX, flip;
+
+    for (flip = 0; flip < 2; flip++)
+    {
+        unsigned int hi = (unsigned int) flip, lo = 0;
+        int err = 0, half;
+
+        for (half = 0; half < 2; half++)
+        {
+            unsigned char px[8][3];
+            int xy[8][2], sum[3] = { 0, 0, 0 }, base[3], idx[8], cw = 0;
+            int x, y, i, k, n = 0;
+
+            /* Gather the half block, left/right or top/bottom. */
+
+            for (x = 0; x < 4; x++)
+                for (y = 0; y < 4; y++)
+                    if ((flip ? y : x) / 2 == half)
+                    {
+                        for (k = 0; k < 3; k++)
+                            sum[k] += (px[n][k] = blk[y][x][k]);
+
+                        xy[n][0] = x;
+                        xy[n][1] = y;
+                        n++;
+                    }
+
+            /* Quantize the average color to 4 bits per channel. */
+
+            for (k = 0; k < 3; k++)
+                base[k] = (sum[k] * 15 + 8 * 255 / 2) / (8 * 255);
+
+            err += etc1_half((const unsigned char (*)[3]) px, base, &cw, idx);
+
+            hi |= (unsigned int) base[0] << (28 - 4 * half);
+            hi |= (unsigned int) base[1] << (20 - 4 * half);
+            hi |= (unsigned int) base[2] << (12 - 4 * half);
+            hi |= (unsigned int) cw      << ( 5 - 3 * half);
+
+            for (i = 0; i < 8; i++)
+            {
+                int j = xy[i][0] * 4 + xy[i][1];
+
+                lo |= (unsigned int) (idx[i] >> 1) << (16 + j);
+                lo |= (unsigned int) (idx[i] &  1) << j;
+            }
+        }
+
+        if (err < best)
+        {
+            best    = err;
+            best_hi = hi;
+            best_lo = lo;
+        }
+    }
+
+    dst[0] = (unsigned char) (best_hi >> 24);
+    dst[1] = (unsigned char) (best_hi >> 16);
+    dst[2] = (unsigned char) (best_hi >>  8);
+    dst[3] = (unsigned char) (best_hi);
+    dst[4] = (unsigned char) (best_lo >> 24);
+    dst[5] = (unsigned char) (best_lo >> 16);
+    dst[6] = (unsigned char) (best_lo >>  8);
+    dst[7] = (unsigned char) (best_lo);
+}
+
+static unsigned char *etc1_encode(const unsigned char *p, int w, int h)
+{
+    unsigned char *q;
+
+    if ((q = malloc(etc1_size(w, h))))
+    {
+        unsigned char blk[4][4][3], *d = q;
+        int bx, by, x, y;
+
+        for (by = 0; by < h; by += 4)
+            for (bx = 0; bx < w; bx += 4, d += 8)
+            {
+                /* Replicate edge pixels into partial blocks. */
+
+                for (y = 0; y < 4; y++)
+                    for (x = 0; x < 4; x++)
+                        memcpy(blk[y][x], p + (MIN(by + y, h - 1) * w +
+                                               MIN(bx + x, w - 1)) * 3, 3);
+
+                etc1_block(d, (const unsigned char (*)[4][3]) blk);
+            }
+    }
+    return q;
+}
+
+static unsigned char *etc1_decode(const unsigned char *p, int w, int h)
+{
+    unsigned char *q;
+
+    if ((q = malloc(w * h * 3)))
+    {
+        const unsigned char *s = p;
+        int bx, by, x, y, k;
+
+        for (by = 0; by < h; by += 4)
+            for (bx = 0; bx < w; bx += 4, s += 8)
+            {
+                unsigned int hi = ((unsigned int) s[0] << 24 |
+                                   (unsigned int) s[1] << 16 |
+                                   (unsigned int) s[2] <<  8 |
+                                   (unsigned int) s[3]);
+                unsigned int lo = ((unsigned int) s[4] << 24 |
+                                   (unsigned int) s[5] << 16 |
+                                   (unsigned int) s[6] <<  8 |
+                                   (unsigned int) s[7]);
+
+                int flip = hi & 1, c[2][3], cw[2];
+
+                cw[0] = (hi >> 5) & 7;
+                cw[1] = (hi >> 2) & 7;
+
+                for (k = 0; k < 3; k++)
+                {
+                    if (hi & 2)
+                    {
+                        /* Differential mode: 5-bit base, 3-bit delta. */
+
+                        int a = (hi >> (27 - 8 * k)) & 31;
+                        int d = (hi >> (24 - 8 * k)) &  7;
+                        int b = a + (d < 4 ? d : d - 8);
+
+                        c[0][k] = (a << 3) | (a >> 2);
+                        c[1][k] = (b << 3) | (b >> 2);
+                    }
+                    else
+                    {
+                        /* Individual mode: two 4-bit bases. */
+
+                        c[0][k] = ((hi >> (28 - 8 * k)) & 15) * 17;
+                        c[1][k] = ((hi >> (24 - 8 * k)) & 15) * 17;
+                    }
+                }
+
+                for (x = 0; x < 4 && bx + x < w; x++)
+                    for (y = 0; y < 4 && by + y < h; y++)
+                    {
+                        int j    = x * 4 + y;
+                        int i    = (((lo >> (16 + j)) & 1) << 1) | ((lo >> j) & 1);
+                        int half = (flip ? y : x) / 2;
+                        int m    = etc1_mod[cw[half]][i];
+
+                        unsigned char *d = q + ((by + y) * w + bx + x) * 3;
+
+                        for (k = 0; k < 3; k++)
+                            d[k] = clamp_byte(c[half][k] + m);
+                    }
+            }
+    }
+    return q;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Box-filter the given image down to half size, clamping at the edges.
+ */
+static unsigned char *mip_next(const unsigned char *p, int w, int h, int b,
+                               int *W, int *H)
+{
+    unsigned char *q;
+
+    *W = MAX(w / 2, 1);
+    *H = MAX(h / 2, 1);
+
+    if ((q = malloc(*W * *H * b)))
+    {
+        int x, y, i;
+
+        for (y = 0; y < *H; y++)
+            for (x = 0; x < *W; x++)
+            {
+                int x0 = MIN(2 * x, w - 1), x1 = MIN(2 * x + 1, w - 1);
+                int y0 = MIN(2 * y, h - 1), y1 = MIN(2 * y + 1, h - 1);
+
+                for (i = 0; i < b; i++)
+                    q[(y * *W + x) * b + i] = (unsigned char)
+                        ((p[(y0 * w + x0) * b + i] +
+                          p[(y0 * w + x1) * b + i] +
+                          p[(y1 * w + x0) * b + i] +
+                          p[(y1 * w + x1) * b + i] + 2) / 4);
+            }
+    }
+    return q;
+}
+
+/*
+ * Build a complete mip chain from the given image. ETC1 applies only
+ * to opaque RGB images; others are stored raw.
+ */
+int ntx_make(struct ntx *t, const void *p, int w, int h, int b, int fmt)
+{
+    int i;
+
+    memset(t, 0, sizeof (*t));
+
+    t->fmt = (fmt == NTX_ETC1 && b == 3) ? NTX_ETC1 : NTX_RAW;
+    t->b   = b;
+
+    if (!(t->lv[0].p = malloc(w * h * b)))
+        return 0;
+
+    memcpy(t->lv[0].p, p, w * h * b);
+
+    t->lv[0].w = w;
+    t->lv[0].h = h;
+    t->lv[0].n = w * h * b;
+    t->c       = 1;
+
+    while ((w > 1 || h > 1) && t->c < NTX_LEVELS)
+    {
+        struct ntx_level *l = t->lv + t->c - 1;
+        struct ntx_level *m = t->lv + t->c;
+
+        if (!(m->p = mip_next(l->p, l->w, l->h, b, &m->w, &m->h)))
+        {
+            ntx_free(t);
+            return 0;
+        }
+
+        m->n = m->w * m->h * b;
+        w    = m->w;
+        h    = m->h;
+
+        t->c++;
+    }
+
+    if (t->fmt == NTX_ETC1)
+        for (i = 0; i < t->c; i++)
+        {
+            unsigned char *q;
+
+            if (!(q = etc1_encode(t->lv[i].p, t->lv[i].w, t->lv[i].h)))
+            {
+                ntx_free(t);
+                return 0;
+            }
+
+            free(t->lv[i].p);
+
+            t->lv[i].p = q;
+            t->lv[i].n = etc1_size(t->lv[i].w, t->lv[i].h);
+        }
+
+    return 1;
+}
+
+void ntx_free(struct ntx *t)
+{
+    int i;
+
+    for (i = 0; i < NTX_LEVELS; i++)
+        free(t->lv[i].p);
+
+    memset(t, 0, sizeof (*t));
+}
+
+/*---------------------------------------------------------------------------*/
+
+int ntx_read(struct ntx *t, const char *path)
+{
+    fs_file fp;
+    int i, ok = 0;
+
+    memset(t, 0, sizeof (*t));
+
+    if ((fp = fs_open(path, "r")))
+    {
+        if (get_index(fp) == NTX_MAGIC && get_index(fp) == NTX_VERSION)
+        {
+            t->fmt = get_index(fp);
+            t->b   = get_index(fp);
+            t->c   = get_index(fp);
+
+            ok = (t->fmt == NTX_RAW || t->fmt == NTX_ETC1) &&
+                 (t->b >= 1 && t->b <= 4) &&
+                 (t->c >= 1 && t->c <= NTX_LEVELS);
+
+            /*
+             * Sizes come from the file. Bound the base level so that no
+             * size overflows, and require each level to halve the one
+             * before it, so that decoders can trust the chain.
+             */
+
+            for (i = 0; ok && i < t->c; i++)
+            {
+                struct ntx_level *l = t->lv + i;
+
+                l->w = get_index(fp);
+                l->h = get_index(fp);
+                l->n = get_index(fp);
+
+                if (i == 0)
+                    ok = (l->w > 0 && l->w <= NTX_SIZE_MAX &&
+                          l->h > 0 && l->h <= NTX_SIZE_MAX);
+                else
+                    ok = (l->w == MAX(t->lv[0].w >> i, 1) &&
+                          l->h == MAX(t->lv[0].h >> i, 1));
+
+                ok = ok &&
+                     (long) l->n == (t->fmt == NTX_ETC1 ?
+                                     (long) etc1_size(l->w, l->h) :
+                                     (long) l->w * l->h * t->b) &&
+                     (l->p = malloc(l->n)) &&
+                     fs_read(l->p, 1, l->n, fp) == l->n;
+            }
+        }
+        fs_close(fp);
+    }
+
+    if (!ok)
+        ntx_free(t);
+
+    return ok;
+}
+
+int ntx_write(const struct ntx *t, const char *path)
+{
+    fs_file fp;
+    int i, ok = 1;
+
+    if ((fp = fs_open(path, "w")))
+    {
+        put_index(fp, NTX_MAGIC);
+        put_index(fp, NTX_VERSION);
+        put_index(fp, t->fmt);
+        put_index(fp, t->b);
+        put_index(fp, t->c);
+
+        for (i = 0; i < t->c; i++)
+        {
+            put_index(fp, t->lv[i].w);
+            put_index(fp, t->lv[i].h);
+            put_index(fp, t->lv[i].n);
+
+            if (fs_write(t->lv[i].p, 1, t->lv[i].n, fp) != t->lv[i].n)
+                ok = 0;
+        }
+        fs_close(fp);
+
+        return ok;
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Return a newly allocated raw copy of the given level. ETC1 levels
+ * decode to RGB.
+ */
+void *ntx_decode(const struct ntx *t, int i)
+{
+    const struct ntx_level *l = t->lv + i;
+    void *q = NULL;
+
+    if (i < 0 || i >= t->c)
+        return NULL;
+
+    if (t->fmt == NTX_ETC1)
+        q = etc1_decode(l->p, l->w, l->h);
+    else if ((q = malloc(l->n)))
+        memcpy(q, l->p, l->n);
+
+    return q;
+}
+
+/*---------------------------------------------------------------------------*/
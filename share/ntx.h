@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef NTX_H
+#define NTX_H
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * NTX texture container: a complete mip chain, stored either as raw
+ * pixels or as ETC1 blocks, ready for upload level by level.
+ */
+
+#define NTX_RAW  0
+#define NTX_ETC1 1
+
+#define NTX_LEVELS   16
+#define NTX_SIZE_MAX 16384                /* Largest side of a level     */
+
+struct ntx_level
+{
+    int w;
+    int h;
+    int n;                              /* Data size in bytes          */
+
+    unsigned char *p;
+};
+
+struct ntx
+{
+    int fmt;                            /* NTX_RAW or NTX_ETC1         */
+    int b;                              /* Bytes per decoded pixel     */
+    int c;                              /* Level count                 */
+
+    struct ntx_level lv[NTX_LEVELS];
+};
+
+int   ntx_make(struct ntx *, const void *, int, int, int, int);
+void  ntx_free(struct ntx *);
+
+int   ntx_read (struct ntx *, const char *);
+int   ntx_write(const struct ntx *, const char *);
+
+void *ntx_decode(const struct ntx *, int);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Convert a PNG or JPG image to an NTX texture container with a full
+ * mip chain. This runs headless, as does mapc.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base_image.h"
+#include "ntx.h"
+#include "fs.h"
+#include "common.h"
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    char src[MAXSTR] = "";
+    char dst[MAXSTR] = "";
+
+    int fmt = NTX_RAW;
+    int ret = 1;
+
+    if (!fs_init(argv[0]))
+    {
+        fprintf(stderr, "Failure to initialize virtual file system: %s\n",
+                fs_error());
+        return 1;
+    }
+
+    if (argc > 1)
+    {
+        struct ntx t;
+        void *p;
+        int w, h, b, argi;
+
+        for (argi = 2; argi < argc; ++argi)
+            if (strcmp(argv[argi], "--etc1") == 0)
+                fmt = NTX_ETC1;
+
+        SAFECPY(src, argv[1]);
+        SAFECPY(dst, base_name_sans(src, strrchr(src, '.')));
+        SAFECAT(dst, ".ntx");
+
+        fs_add_path     (dir_name(src));
+        fs_set_write_dir(dir_name(src));
+
+        if ((p = image_load(base_name(src), &w, &h, &b)))
+        {
+            if (ntx_make(&t, p, w, h, b, fmt))
+            {
+                if (ntx_write(&t, dst))
+                {
+                    int i, n = 0;
+
+                    for (i = 0; i < t.c; i++)
+                        n += t.lv[i].n;
+
+                    printf("%s (%dx%dx%d, %d levels, %s, %d bytes)\n", dst,
+                           w, h, b, t.c,
+                           t.fmt == NTX_ETC1 ? "ETC1" : "raw", n);
+                    ret = 0;
+                }
+                else fprintf(stderr, "Failure to write %s\n", dst);
+
+                ntx_free(&t);
+            }
+            free(p);
+        }
+        else fprintf(stderr, "Failure to load %s\n", src);
+    }
+    else fprintf(stderr, "Usage: %s <image> [--etc1]\n", argv[0]);
+
+    fs_quit();
+
+    return ret;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Bundle compiled levels with everything they load into one .nbp file:
+ * the SOL, its material textures, the background SOL and gradient. Files
+ * are stored in the order the game loads them. Texture probes that come
+ * up empty are listed too, so that the game skips them without asking
+ * the file system. Run as
+ *
+ *     packc <bundle> <data> <level.sol>...
+ *
+ * with paths relative to the data directory, where the bundle is written.
+ * Bundles in the data directory are mounted at startup, unless a file
+ * they hold has changed since or a path they list as missing has been
+ * added; rebuild them when their levels change.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "solid_base.h"
+#include "binary.h"
+#include "fs.h"
+#include "fs_zip.h"
+#include "array.h"
+#include "common.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define ALIGN(n) (((n) + BUNDLE_ALIGN - 1) & ~(BUNDLE_ALIGN - 1))
+
+struct item
+{
+    char  path[MAXSTR];
+    int   absent;
+    void *data;
+    int   size;
+};
+
+static Array items;
+
+static int add_file(const char *path)
+{
+    struct item *ip;
+    fs_file fp;
+    int i;
+
+    for (i = 0; i < array_len(items); i++)
+    {
+        ip = array_get(items, i);
+
+        if (strcmp(ip->path, path) == 0)
+            return !ip->absent;
+    }
+
+    if ((ip = array_add(items)))
+    {
+        memset(ip, 0, sizeof (*ip));
+        SAFECPY(ip->path, path);
+
+        ip->absent = 1;
+
+        if ((fp = fs_open(path, "r")))
+        {
+            ip->size = fs_length(fp);
+
+            if ((ip->data = malloc(MAX(ip->size, 1))) &&
+                fs_read(ip->data, 1, ip->size, fp) == ip->size)
+                ip->absent = 0;
+            else
+                fprintf(stderr, "Failure to read %s\n", path);
+
+            fs_close(fp);
+        }
+        return !ip->absent;
+    }
+    return 0;
+}
+
+/*
+ * Probe for a texture in the order the game does.
+ */
+static void add_texture(const char *name)
+{
+    char path[MAXSTR];
+    int i;
+
+    for (i = 0; i < ARRAYSIZE(tex_paths); i++)
+    {
+        CONCAT_PATH(path, &tex_paths[i], name);
+
+        if (add_file(path))
+            return;
+    }
+
+    fprintf(stderr, "Warning: no texture for %s\n", name);
+}
+
+static int add_sol(const char *path, struct s_base *base)
+{
+    int i;
+
+    if (!add_file(path) || !sol_load_base(base, path))
+    {
+        fprintf(stderr, "Failure to load %s\n", path);
+        return 0;
+    }
+
+    for (i = 0; i < base->mc; i++)
+        if (base->mv[i].f[0])
+            add_texture(base->mv[i].f);
+
+    return 1;
+}
+
+/*
+ * Add a level and its background, as game_client_init loads them.
+ */
+static int add_level(const char *path)
+{
+    struct s_base base, back;
+    const char *back_name = NULL;
+    const char *grad_name = NULL;
+    int i;
+
+    if (!add_sol(path, &base))
+        return 0;
+
+    for (i = 0; i < base.dc; i++)
+    {
+        const char *k = base.av + base.dv[i].ai;
+        const char *v = base.av + base.dv[i].aj;
+
+        if (strcmp(k, "back") == 0) back_name = v;
+        if (strcmp(k, "grad") == 0) grad_name = v;
+    }
+
+    if (add_sol("geom/back/back.sol", &back))
+        sol_free_base(&back);
+
+    if (grad_name && *grad_name && !add_file(grad_name))
+        fprintf(stderr, "Warning: no gradient %s\n", grad_name);
+
+    if (back_name && *back_name && add_sol(back_name, &back))
+        sol_free_base(&back);
+
+    sol_free_base(&base);
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void put_pad(fs_file fout, int n)
+{
+    while (n-- > 0)
+        fs_putc(0, fout);
+}
+
+static int write_bundle(const char *path)
+{
+    fs_file fout;
+    int i, n = array_len(items), names_len = 0, off, pos;
+
+    for (i = 0; i < n; i++)
+        names_len += strlen(((struct item *) array_get(items, i))->path) + 1;
+
+    if (!(fout = fs_open(path, "w")))
+        return 0;
+
+    put_index(fout, BUNDLE_MAGIC);
+    put_index(fout, n);
+    put_index(fout, names_len);
+    put_index(fout, 0);
+
+    /* Index. */
+
+    pos = 16 + 16 * n + names_len;
+    off = ALIGN(pos);
+
+    for (names_len = 0, i = 0; i < n; i++)
+    {
+        const struct item *ip = array_get(items, i);
+
+        put_index(fout, names_len);
+        put_index(fout, ip->absent ? 0 : off);
+        put_index(fout, ip->absent ? 0 : ip->size);
+        put_index(fout, ip->absent ? BUNDLE_ABSENT : 0);
+
+        names_len += strlen(ip->path) + 1;
+
+        if (!ip->absent)
+            off = ALIGN(off + ip->size);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        const struct item *ip = array_get(items, i);
+
+        fs_write(ip->path, 1, strlen(ip->path) + 1, fout);
+    }
+
+    /* Data, each file aligned. */
+
+    for (i = 0; i < n; i++)
+    {
+        const struct item *ip = array_get(items, i);
+
+        if (!ip->absent)
+        {
+            put_pad(fout, ALIGN(pos) - pos);
+            pos = ALIGN(pos);
+
+            fs_write(ip->data, 1, ip->size, fout);
+            pos += ip->size;
+        }
+    }
+
+    fs_close(fout);
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    int argi, ret = 1;
+
+    if (!fs_init(argv[0]))
+    {
+        fprintf(stderr, "Failure to initialize virtual file system: %s\n",
+                fs_error());
+        return 1;
+    }
+
+    if (argc > 3)
+    {
+        fs_add_path     (argv[2]);
+        fs_set_write_dir(argv[2]);
+
+        if ((items = array_new(sizeof (struct item))))
+        {
+            int i, n = 0, bytes = 0;
+
+            ret = 0;
+
+            for (argi = 3; argi < argc; argi++)
+                if (!add_level(argv[argi]))
+                    ret = 1;
+
+            if (ret == 0)
+            {
+                if (write_bundle(argv[1]))
+                {
+                    for (i = 0; i < array_len(items); i++)
+                    {
+                        const struct item *ip = array_get(items, i);
+
+                        if (!ip->absent)
+                        {
+                            bytes += ip->size;
+                            n++;
+                        }
+                    }
+
+                    printf("%s (%d files, %d bytes, %d missing)\n", argv[1],
+                           n, bytes, array_len(items) - n);
+                }
+                else
+                {
+                    fprintf(stderr, "Failure to write %s\n", argv[1]);
+                    ret = 1;
+                }
+            }
+
+            for (i = 0; i < array_len(items); i++)
+                free(((struct item *) array_get(items, i))->data);
+
+            array_free(items);
+        }
+    }
+    else fprintf(stderr, "Usage: %s <bundle> <data> <level.sol>...\n", argv[0]);
+
+    fs_quit();
+
+    return ret;
+}
+
+/*---------------------------------------------------------------------------*/
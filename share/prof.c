@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "prof.h"
+#include "common.h"
+#include "log.h"
+#include "fs.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define PROF_THREADS 8                  /* Threads that can be traced        */
+#define PROF_EVENTS  (1 << 15)          /* Events kept per thread            */
+#define PROF_DEPTH   32                 /* Nesting depth per thread          */
+
+struct prof_event
+{
+    const char *name;
+    Uint64      t0;
+    Uint64      t1;
+};
+
+struct prof_ring
+{
+    SDL_atomic_t state;                 /* One of the RING_ states below     */
+    SDL_threadID id;
+
+    struct prof_event *ev;
+    SDL_atomic_t       head;            /* Events written so far             */
+
+    int         depth;                  /* Open scopes                       */
+    const char *name[PROF_DEPTH];
+    Uint64      t0[PROF_DEPTH];
+};
+
+enum
+{
+    RING_FREE,
+    RING_CLAIM,
+    RING_LIVE,
+    RING_DONE                           /* Thread exited, events still kept  */
+};
+
+static struct prof_ring rings[PROF_THREADS];
+
+static SDL_atomic_t prof_tls;           /* Ring of the calling thread        */
+static SDL_SpinLock prof_tls_lock;
+
+/*
+ * Give a ring back when its thread exits. Its events stay in place for
+ * dumps until another thread claims it.
+ */
+static void prof_release(void *data)
+{
+    SDL_AtomicSet(&((struct prof_ring *) data)->state, RING_DONE);
+}
+
+static struct prof_ring *prof_claim(int state)
+{
+    int i;
+
+    for (i = 0; i < PROF_THREADS; i++)
+        if (SDL_AtomicCAS(&rings[i].state, state, RING_CLAIM))
+        {
+            struct prof_ring *r = &rings[i];
+
+            if (r->ev || (r->ev = malloc(PROF_EVENTS * sizeof (*r->ev))))
+            {
+                r->id    = SDL_ThreadID();
+                r->depth = 0;
+
+                SDL_AtomicSet(&r->head, 0);
+                SDL_AtomicSet(&r->state, RING_LIVE);
+                return r;
+            }
+
+            SDL_AtomicSet(&r->state, state);
+            break;
+        }
+
+    return NULL;
+}
+
+/*
+ * Find the calling thread's ring, claiming one on first use: a free ring
+ * if there is one, else the ring of a thread that has exited.
+ */
+static struct prof_ring *prof_ring(void)
+{
+    struct prof_ring *r;
+    SDL_TLSID tls;
+
+    if (!(tls = SDL_AtomicGet(&prof_tls)))
+    {
+        SDL_AtomicLock(&prof_tls_lock);
+
+        if (!(tls = SDL_AtomicGet(&prof_tls)))
+        {
+            tls = SDL_TLSCreate();
+            SDL_AtomicSet(&prof_tls, tls);
+        }
+
+        SDL_AtomicUnlock(&prof_tls_lock);
+    }
+
+    if ((r = SDL_TLSGet(tls)))
+        return r;
+
+    if ((r = prof_claim(RING_FREE)) || (r = prof_claim(RING_DONE)))
+        SDL_TLSSet(tls, r, prof_release);
+
+    return r;
+}
+
+void prof_begin(const char *name)
+{
+    struct prof_ring *r;
+
+    if ((r = prof_ring()))
+    {
+        if (r->depth < PROF_DEPTH)
+        {
+            r->name[r->depth] = name;
+            r->t0  [r->depth] = SDL_GetPerformanceCounter();
+        }
+        r->depth++;
+    }
+}
+
+void prof_end(void)
+{
+    struct prof_ring *r;
+
+    if ((r = prof_ring()) && r->depth > 0)
+    {
+        if (--r->depth < PROF_DEPTH)
+        {
+            int n = SDL_AtomicGet(&r->head);
+
+            struct prof_event *e = &r->ev[n & (PROF_EVENTS - 1)];
+
+            e->name = r->name[r->depth];
+            e->t0   = r->t0  [r->depth];
+            e->t1   = SDL_GetPerformanceCounter();
+
+            SDL_AtomicSet(&r->head, n + 1);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Write the events held in all rings as Chrome trace-event JSON. Threads
+ * other than the caller keep recording; an event overwritten during the
+ * dump may come out garbled, which is fine for a diagnostic.
+ */
+void prof_dump(void)
+{
+    static int count = 0;
+
+    char   path[MAXSTR];
+    fs_file fp;
+
+    double k = 1.0e6 / (double) SDL_GetPerformanceFrequency();
+    Uint64 base = 0;
+    int i, j, n, m, c = 0;
+
+    /* Find the oldest event to measure time from. */
+
+    for (i = 0; i < PROF_THREADS; i++)
+        if (SDL_AtomicGet(&rings[i].state) >= RING_LIVE)
+        {
+            n = SDL_AtomicGet(&rings[i].head);
+            m = MAX(n - PROF_EVENTS, 0);
+
+            if (n > m)
+            {
+                Uint64 t = rings[i].ev[m & (PROF_EVENTS - 1)].t0;
+
+                if (base == 0 || t < base)
+                    base = t;
+            }
+        }
+
+    fs_mkdir("Profile");
+
+    sprintf(path, "Profile/trace%05d.json", count++);
+
+    if ((fp = fs_open(path, "w")))
+    {
+        fs_puts("{\"traceEvents\":[\n", fp);
+
+        for (i = 0; i < PROF_THREADS; i++)
+            if (SDL_AtomicGet(&rings[i].state) >= RING_LIVE)
+            {
+                n = SDL_AtomicGet(&rings[i].head);
+
+                for (j = MAX(n - PROF_EVENTS, 0); j < n; j++)
+                {
+                    const struct prof_event *e =
+                        &rings[i].ev[j & (PROF_EVENTS - 1)];
+
+                    fs_printf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\","
+                              "\"pid\":1,\"tid\":%d,"
+                              "\"ts\":%.3f,\"dur\":%.3f}",
+                              c++ ? ",\n" : "", e->name, i,
+                              k * (double) (Sint64) (e->t0 - base),
+                              k * (double) (e->t1 - e->t0));
+                }
+            }
+
+        fs_puts("\n],\"displayTimeUnit\":\"ms\"}\n", fp);
+        fs_close(fp);
+
+        log_printf("Wrote %d trace events to %s\n", c, path);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+/*
+ * Scoped timers. Wrap a block in PROF_BEGIN("name") and PROF_END() to
+ * record its duration into a per-thread ring. PROF_DUMP() writes the
+ * rings out as a Chrome trace (chrome://tracing, Perfetto). Unless
+ * built with ENABLE_PROF=1 these expand to nothing.
+ */
+
+#if ENABLE_PROF
+
+void prof_begin(const char *);
+void prof_end(void);
+void prof_dump(void);
+
+#define PROF_BEGIN(name) prof_begin(name)
+#define PROF_END()       prof_end()
+#define PROF_DUMP()      prof_dump()
+
+#else
+
+#define PROF_BEGIN(name) ((void) 0)
+#define PROF_END()       ((void) 0)
+#define PROF_DUMP()      ((void) 0)
+
+#endif
+
+#endif
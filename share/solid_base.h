@@ -356,7 +356,7 @@ struct path
     SAFECAT((dst), (path)->suffix);       \
 } while (0)
 
-extern const struct path tex_paths[4];
+extern const struct path tex_paths[5];
 extern const struct path mtrl_paths[2];
 
 /*---------------------------------------------------------------------------*/
@@ -32,6 +32,7 @@
 
 #include "solid_draw.h"
 #include "solid_all.h"
+#include "loadtime.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -360,6 +361,8 @@ static void sol_load_mesh(struct d_mesh *mp,
 
         /* Initialize buffer objects for all data. */
 
+        loadtime_enter("vbo");
+
         glGenBuffers_(1, &mp->vbo);
         glBindBuffer_(GL_ARRAY_BUFFER,         mp->vbo);
         glBufferData_(GL_ARRAY_BUFFER,         vn * vs, vv, GL_STATIC_DRAW);
@@ -370,6 +373,8 @@ static void sol_load_mesh(struct d_mesh *mp,
         glBufferData_(GL_ELEMENT_ARRAY_BUFFER, gn * gs, gv, GL_STATIC_DRAW);
         glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
 
+        loadtime_leave();
+
         /* Note cached material index. */
 
         mp->mtrl = draw->base->mtrls[mi];
@@ -507,7 +512,9 @@ int sol_load_draw(struct s_draw *draw, struct s_vary *vary, int s)
 
     /* Cache all materials for this file. */
 
+    loadtime_enter("mtrl_cache_sol");
     mtrl_cache_sol(draw->base);
+    loadtime_leave();
 
     /* Initialize shadow state. */
 
@@ -16,6 +16,7 @@
 
 #include "vec3.h"
 #include "common.h"
+#include "prof.h"
 
 #include "solid_vary.h"
 #include "solid_sim.h"
@@ -610,6 +611,8 @@ static float sol_test_file(float dt,
     float U[3], W[3], u, t = dt;
     int i;
 
+    PROF_BEGIN("sol_test_file");
+
     for (i = 0; i < vary->bc; i++)
     {
         const struct v_body *bp = vary->bv + i;
@@ -621,6 +624,9 @@ static float sol_test_file(float dt,
             t = u;
         }
     }
+
+    PROF_END();
+
     return t;
 }
 
@@ -732,6 +738,8 @@ float sol_step(struct s_vary *vary, cmd_fn cmd_func,
     float P[3], V[3], v[3], r[3], a[3], d, nt, b = 0.0f, tt = dt;
     int c;
 
+    PROF_BEGIN("sol_step");
+
     if (ui < vary->uc)
     {
         struct v_ball *up = vary->uv + ui;
@@ -809,6 +817,8 @@ float sol_step(struct s_vary *vary, cmd_fn cmd_func,
         sol_pendulum(up, a, g, dt);
     }
 
+    PROF_END();
+
     return b;
 }
 
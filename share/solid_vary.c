@@ -13,6 +13,8 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <assert.h>
 
 #include "solid_vary.h"
 #include "common.h"
@@ -162,6 +164,568 @@ void sol_free_vary(struct s_vary *fp)
     memset(fp, 0, sizeof (*fp));
 }
 
+/*
+ * Make a deep copy of the varying state. The copy shares the base.
+ */
+int sol_copy_vary(struct s_vary *dst, const struct s_vary *src)
+{
+    memset(dst, 0, sizeof (*dst));
+
+    dst->base     = src->base;
+    dst->ms_accum = src->ms_accum;
+
+#define COPY(v, c) do {                                                 \
+        if (src->c)                                                     \
+        {                                                               \
+            if (!(dst->v = malloc(src->c * sizeof (*src->v))))          \
+                goto fail;                                              \
+            memcpy(dst->v, src->v, src->c * sizeof (*src->v));          \
+            dst->c = src->c;                                            \
+        }                                                               \
+    } while (0)
+
+    COPY(pv, pc);
+    COPY(bv, bc);
+    COPY(mv, mc);
+    COPY(hv, hc);
+    COPY(xv, xc);
+    COPY(uv, uc);
+
+#undef COPY
+
+    return 1;
+
+fail:
+    sol_free_vary(dst);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * The snapshot arena holds, in order, the paths, moves, items, switches
+ * and balls, each array starting on an aligned boundary, then ms_accum.
+ */
+
+#define SNAP_ALIGN(n) (((n) + 15) & ~((size_t) 15))
+
+struct snap_layout
+{
+    size_t pv, mv, hv, xv, uv, ms, size;
+};
+
+static void snap_layout(struct snap_layout *l, const struct s_vary_snap *sp)
+{
+    l->pv   = 0;
+    l->mv   = SNAP_ALIGN(l->pv + sp->pc * sizeof (struct v_path));
+    l->hv   = SNAP_ALIGN(l->mv + sp->mc * sizeof (struct v_move));
+    l->xv   = SNAP_ALIGN(l->hv + sp->hc * sizeof (struct v_item));
+    l->uv   = SNAP_ALIGN(l->xv + sp->xc * sizeof (struct v_swch));
+    l->ms   = SNAP_ALIGN(l->uv + sp->uc * sizeof (struct v_ball));
+    l->size = l->ms + sizeof (float);
+}
+
+static int snap_match(const struct s_vary_snap *sp, const struct s_vary *fp)
+{
+    return (sp->data &&
+            sp->pc == fp->pc &&
+            sp->mc == fp->mc &&
+            sp->hc == fp->hc &&
+            sp->xc == fp->xc &&
+            sp->uc == fp->uc);
+}
+
+/*
+ * Size the arena of a snapshot for the given state.
+ */
+int sol_vary_snap_init(struct s_vary_snap *sp, const struct s_vary *fp)
+{
+    struct snap_layout l;
+
+    memset(sp, 0, sizeof (*sp));
+
+    sp->pc = fp->pc;
+    sp->mc = fp->mc;
+    sp->hc = fp->hc;
+    sp->xc = fp->xc;
+    sp->uc = fp->uc;
+
+    snap_layout(&l, sp);
+
+    if ((sp->data = malloc(l.size)))
+    {
+        sp->size = l.size;
+        return 1;
+    }
+    return 0;
+}
+
+void sol_vary_snap_free(struct s_vary_snap *sp)
+{
+    free(sp->data);
+    memset(sp, 0, sizeof (*sp));
+}
+
+/*
+ * Copy the mutable state into the arena. The element counts must match
+ * those the snapshot was sized for.
+ */
+int sol_vary_snapshot(struct s_vary_snap *sp, const struct s_vary *fp)
+{
+    struct snap_layout l;
+    unsigned char *d = sp->data;
+
+    if (!snap_match(sp, fp))
+        return 0;
+
+    snap_layout(&l, sp);
+
+    memcpy(d + l.pv, fp->pv, fp->pc * sizeof (*fp->pv));
+    memcpy(d + l.mv, fp->mv, fp->mc * sizeof (*fp->mv));
+    memcpy(d + l.hv, fp->hv, fp->hc * sizeof (*fp->hv));
+    memcpy(d + l.xv, fp->xv, fp->xc * sizeof (*fp->xv));
+    memcpy(d + l.uv, fp->uv, fp->uc * sizeof (*fp->uv));
+    memcpy(d + l.ms, &fp->ms_accum, sizeof (fp->ms_accum));
+
+    return 1;
+}
+
+/*
+ * Copy the mutable state from the arena back into the given state.
+ */
+int sol_vary_restore(struct s_vary *fp, const struct s_vary_snap *sp)
+{
+    struct snap_layout l;
+    const unsigned char *d = sp->data;
+
+    if (!snap_match(sp, fp))
+        return 0;
+
+    snap_layout(&l, sp);
+
+    memcpy(fp->pv, d + l.pv, fp->pc * sizeof (*fp->pv));
+    memcpy(fp->mv, d + l.mv, fp->mc * sizeof (*fp->mv));
+    memcpy(fp->hv, d + l.hv, fp->hc * sizeof (*fp->hv));
+    memcpy(fp->xv, d + l.xv, fp->xc * sizeof (*fp->xv));
+    memcpy(fp->uv, d + l.uv, fp->uc * sizeof (*fp->uv));
+    memcpy(&fp->ms_accum, d + l.ms, sizeof (fp->ms_accum));
+
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Undo history. A record is a run of 32-bit words laid out as
+ *
+ *     length, { tag, mask..., word... }..., length
+ *
+ * where each tag names an element by kind and index, each mask bit marks a
+ * word of that element changed by the step, and the words hold its values
+ * from before the step. The length at either end lets records be dropped
+ * from the old end of the ring and popped from the new one.
+ */
+
+enum
+{
+    HIST_PATH = 1,
+    HIST_MOVE,
+    HIST_ITEM,
+    HIST_SWCH,
+    HIST_BALL,
+    HIST_MS,
+    HIST_EXT
+};
+
+#define HIST_TAG(k, i) ((unsigned int) (k) << 24 | (unsigned int) (i))
+#define HIST_KIND(t)   ((int) ((t) >> 24))
+#define HIST_INDEX(t)  ((int) ((t) & 0xFFFFFF))
+
+#define WORDS(n) ((int) (((n) + 3) / 4))
+#define MASKS(w) (((w) + 31) / 32)
+
+static int hist_max(int c, int w)
+{
+    return c * (1 + MASKS(w) + w);
+}
+
+/*
+ * Write to OUT the words of OLD that differ from CUR. Return the number of
+ * words written, or zero if there are none.
+ */
+static int hist_diff(unsigned int *out, unsigned int tag,
+                     const void *old, const void *cur, int w)
+{
+    const unsigned char *a = (const unsigned char *) old;
+    const unsigned char *b = (const unsigned char *) cur;
+
+    unsigned int *mask = out + 1;
+
+    int m = MASKS(w), n = 1 + m, i;
+
+    if (memcmp(a, b, w * 4) == 0)
+        return 0;
+
+    out[0] = tag;
+    memset(mask, 0, m * sizeof (*mask));
+
+    for (i = 0; i < w; i++)
+        if (memcmp(a + i * 4, b + i * 4, 4) != 0)
+        {
+            mask[i / 32] |= 1u << (i % 32);
+            memcpy(out + n++, a + i * 4, 4);
+        }
+
+    return n;
+}
+
+/*
+ * Write the words read from IN back into the element at P. Return the
+ * number of words read.
+ */
+static int hist_undo(const unsigned int *in, void *p, int w)
+{
+    const unsigned int *mask = in + 1;
+
+    unsigned char *d = (unsigned char *) p;
+
+    int m = MASKS(w), n = 1 + m, i;
+
+    for (i = 0; i < w; i++)
+        if (mask[i / 32] & (1u << (i % 32)))
+            memcpy(d + i * 4, in + n++, 4);
+
+    return n;
+}
+
+/*
+ * Size the record scratch for the element counts of the given state.
+ */
+static int hist_temp(struct s_hist *h, const struct s_vary *fp)
+{
+    unsigned int *temp;
+
+    int n = (2 +
+             hist_max(fp->pc, WORDS(sizeof (struct v_path))) +
+             hist_max(fp->mc, WORDS(sizeof (struct v_move))) +
+             hist_max(fp->hc, WORDS(sizeof (struct v_item))) +
+             hist_max(fp->xc, WORDS(sizeof (struct v_swch))) +
+             hist_max(fp->uc, WORDS(sizeof (struct v_ball))) +
+             hist_max(1, 1) +
+             hist_max(1, WORDS(h->ext_size)));
+
+    if (n > h->temp_size)
+    {
+        if (!(temp = realloc(h->temp, n * sizeof (*temp))))
+            return 0;
+
+        h->temp      = temp;
+        h->temp_size = n;
+    }
+    return 1;
+}
+
+/*
+ * Allocate a history of the given size in words for the given state, with
+ * the given number of bytes of extra state per step.
+ */
+int sol_hist_init(struct s_hist *h, const struct s_vary *fp, int size, int ext)
+{
+    memset(h, 0, sizeof (*h));
+
+    assert(ext % 4 == 0);
+
+    h->ext_size = ext;
+
+    if (sol_vary_snap_init(&h->prev, fp) && hist_temp(h, fp))
+    {
+        h->size = MAX(size, h->temp_size);
+
+        if ((h->ring = malloc(h->size * sizeof (*h->ring))) &&
+            (!ext || (h->prev_ext = calloc(1, ext))))
+        {
+            sol_vary_snapshot(&h->prev, fp);
+            return 1;
+        }
+    }
+
+    sol_hist_free(h);
+    return 0;
+}
+
+void sol_hist_free(struct s_hist *h)
+{
+    sol_vary_snap_free(&h->prev);
+
+    free(h->ring);
+    free(h->temp);
+    free(h->prev_ext);
+
+    memset(h, 0, sizeof (*h));
+}
+
+/*
+ * Drop all records and take the given state as the new starting point.
+ */
+void sol_hist_clear(struct s_hist *h, const struct s_vary *fp, const void *ext)
+{
+    h->head  = 0;
+    h->used  = 0;
+    h->count = 0;
+
+    /* Resize for a changed element count. */
+
+    if (!snap_match(&h->prev, fp))
+    {
+        sol_vary_snap_free(&h->prev);
+
+        if (!sol_vary_snap_init(&h->prev, fp) || !hist_temp(h, fp))
+            sol_vary_snap_free(&h->prev);
+
+        if (h->size < h->temp_size)
+        {
+            free(h->ring);
+
+            if ((h->ring = malloc(h->temp_size * sizeof (*h->ring))))
+                h->size = h->temp_size;
+            else
+                h->size = 0;
+        }
+    }
+
+    sol_vary_snapshot(&h->prev, fp);
+
+    if (h->prev_ext && ext)
+        memcpy(h->prev_ext, ext, h->ext_size);
+}
+
+/*
+ * Record the changes made by a step, given the state after it.
+ */
+int sol_hist_push(struct s_hist *h, const struct s_vary *fp, const void *ext)
+{
+    const unsigned char *d = (const unsigned char *) h->prev.data;
+
+    struct snap_layout l;
+    unsigned int *t = h->temp;
+    int n = 1, i, j;
+
+    if (!h->ring || !snap_match(&h->prev, fp))
+    {
+        sol_hist_clear(h, fp, ext);
+        return 0;
+    }
+
+    snap_layout(&l, &h->prev);
+
+    for (i = 0; i < fp->pc; i++)
+        n += hist_diff(t + n, HIST_TAG(HIST_PATH, i),
+                       d + l.pv + i * sizeof (*fp->pv), fp->pv + i,
+                       WORDS(sizeof (*fp->pv)));
+    for (i = 0; i < fp->mc; i++)
+        n += hist_diff(t + n, HIST_TAG(HIST_MOVE, i),
+                       d + l.mv + i * sizeof (*fp->mv), fp->mv + i,
+                       WORDS(sizeof (*fp->mv)));
+    for (i = 0; i < fp->hc; i++)
+        n += hist_diff(t + n, HIST_TAG(HIST_ITEM, i),
+                       d + l.hv + i * sizeof (*fp->hv), fp->hv + i,
+                       WORDS(sizeof (*fp->hv)));
+    for (i = 0; i < fp->xc; i++)
+        n += hist_diff(t + n, HIST_TAG(HIST_SWCH, i),
+                       d + l.xv + i * sizeof (*fp->xv), fp->xv + i,
+                       WORDS(sizeof (*fp->xv)));
+    for (i = 0; i < fp->uc; i++)
+        n += hist_diff(t + n, HIST_TAG(HIST_BALL, i),
+                       d + l.uv + i * sizeof (*fp->uv), fp->uv + i,
+                       WORDS(sizeof (*fp->uv)));
+
+    n += hist_diff(t + n, HIST_TAG(HIST_MS, 0),
+                   d + l.ms, &fp->ms_accum, 1);
+
+    if (h->ext_size && ext)
+        n += hist_diff(t + n, HIST_TAG(HIST_EXT, 0),
+                       h->prev_ext, ext, WORDS(h->ext_size));
+
+    t[0] = t[n] = n + 1;
+    n++;
+
+    /* Make room by dropping the oldest records. */
+
+    while (h->count && h->used + n > h->size)
+    {
+        h->used -= h->ring[(h->head - h->used + h->size) % h->size];
+        h->count--;
+    }
+
+    for (j = 0; j < n; j++)
+        h->ring[(h->head + j) % h->size] = t[j];
+
+    h->head   = (h->head + n) % h->size;
+    h->used  += n;
+    h->count += 1;
+    h->bytes += n * sizeof (*t);
+
+    /* This state is the base of the next record. */
+
+    sol_vary_snapshot(&h->prev, fp);
+
+    if (h->ext_size && ext)
+        memcpy(h->prev_ext, ext, h->ext_size);
+
+    return 1;
+}
+
+/*
+ * Undo the latest recorded step. Changes to paths, movers, switches and
+ * items are reported to the given command function; the caller is left to
+ * report balls and its extra state.
+ */
+int sol_hist_pop(struct s_hist *h, struct s_vary *fp, void *ext,
+                 void (*cmd_func)(const union cmd *))
+{
+    unsigned int *t = h->temp;
+    union cmd cmd;
+    int i, n, items = 0;
+
+    if (!h->count || !snap_match(&h->prev, fp))
+        return 0;
+
+    /* Start from the recorded state. */
+
+    sol_vary_restore(fp, &h->prev);
+
+    if (h->ext_size && ext)
+        memcpy(ext, h->prev_ext, h->ext_size);
+
+    /* Copy the newest record out of the ring. */
+
+    n = h->ring[(h->head - 1 + h->size) % h->size];
+
+    h->head   = (h->head - n + h->size) % h->size;
+    h->used  -= n;
+    h->count -= 1;
+
+    for (i = 0; i < n; i++)
+        t[i] = h->ring[(h->head + i) % h->size];
+
+    /* Undo each element. */
+
+    for (i = 1; i < n - 1; )
+    {
+        int k = HIST_INDEX(t[i]);
+
+        switch (HIST_KIND(t[i]))
+        {
+        case HIST_PATH:
+            i += hist_undo(t + i, fp->pv + k, WORDS(sizeof (*fp->pv)));
+
+            if (cmd_func)
+            {
+                cmd.type        = CMD_PATH_FLAG;
+                cmd.pathflag.pi = k;
+                cmd.pathflag.f  = fp->pv[k].f;
+                cmd_func(&cmd);
+            }
+            break;
+
+        case HIST_MOVE:
+            i += hist_undo(t + i, fp->mv + k, WORDS(sizeof (*fp->mv)));
+
+            if (cmd_func)
+            {
+                cmd.type        = CMD_MOVE_TIME;
+                cmd.movetime.mi = k;
+                cmd.movetime.t  = fp->mv[k].t;
+                cmd_func(&cmd);
+
+                cmd.type        = CMD_MOVE_PATH;
+                cmd.movepath.mi = k;
+                cmd.movepath.pi = fp->mv[k].pi;
+                cmd_func(&cmd);
+            }
+            break;
+
+        case HIST_ITEM:
+            i += hist_undo(t + i, fp->hv + k, WORDS(sizeof (*fp->hv)));
+            items = 1;
+            break;
+
+        case HIST_SWCH:
+        {
+            int f = fp->xv[k].f;
+            int e = fp->xv[k].e;
+
+            i += hist_undo(t + i, fp->xv + k, WORDS(sizeof (*fp->xv)));
+
+            if (cmd_func && f != fp->xv[k].f)
+            {
+                cmd.type          = CMD_SWCH_TOGGLE;
+                cmd.swchtoggle.xi = k;
+                cmd_func(&cmd);
+            }
+            if (cmd_func && e != fp->xv[k].e)
+            {
+                cmd.type = fp->xv[k].e ? CMD_SWCH_ENTER : CMD_SWCH_EXIT;
+
+                if (fp->xv[k].e)
+                    cmd.swchenter.xi = k;
+                else
+                    cmd.swchexit.xi = k;
+
+                cmd_func(&cmd);
+            }
+            break;
+        }
+
+        case HIST_BALL:
+            i += hist_undo(t + i, fp->uv + k, WORDS(sizeof (*fp->uv)));
+            break;
+
+        case HIST_MS:
+            i += hist_undo(t + i, &fp->ms_accum, 1);
+            break;
+
+        case HIST_EXT:
+            i += hist_undo(t + i, ext ? ext : h->prev_ext,
+                           WORDS(h->ext_size));
+            break;
+
+        default:
+            i = n;
+            break;
+        }
+    }
+
+    /* Items can only be re-created whole. */
+
+    if (items && cmd_func)
+    {
+        cmd.type = CMD_CLEAR_ITEMS;
+        cmd_func(&cmd);
+
+        for (i = 0; i < fp->hc; i++)
+        {
+            cmd.type = CMD_MAKE_ITEM;
+
+            v_cpy(cmd.mkitem.p, fp->hv[i].p);
+
+            cmd.mkitem.t = fp->hv[i].t;
+            cmd.mkitem.n = fp->hv[i].n;
+
+            cmd_func(&cmd);
+        }
+    }
+
+    /* This state is the base of the next record. */
+
+    sol_vary_snapshot(&h->prev, fp);
+
+    if (h->ext_size && ext)
+        memcpy(h->prev_ext, ext, h->ext_size);
+
+    return 1;
+}
+
 /*---------------------------------------------------------------------------*/
 
 int sol_vary_cmd(struct s_vary *fp, struct cmd_state *cs, const union cmd *cmd)
@@ -101,10 +101,36 @@ struct s_vary
 /*---------------------------------------------------------------------------*/
 
 int  sol_load_vary(struct s_vary *, struct s_base *);
+int  sol_copy_vary(struct s_vary *, const struct s_vary *);
 void sol_free_vary(struct s_vary *);
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * A snapshot of the mutable simulation state of an s_vary, stored in a
+ * single arena sized once for a given file and ball count.
+ */
+
+struct s_vary_snap
+{
+    int pc;
+    int mc;
+    int hc;
+    int xc;
+    int uc;
+
+    size_t size;
+    void  *data;
+};
+
+int  sol_vary_snap_init(struct s_vary_snap *, const struct s_vary *);
+void sol_vary_snap_free(struct s_vary_snap *);
+
+int  sol_vary_snapshot(struct s_vary_snap *, const struct s_vary *);
+int  sol_vary_restore (struct s_vary *, const struct s_vary_snap *);
+
+/*---------------------------------------------------------------------------*/
+
 /*
  * Buffers changes to the varying SOL data for interpolation purposes.
  */
@@ -148,4 +174,38 @@ int  sol_lerp_cmd(struct s_lerp *, struct cmd_state *, const union cmd *);
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * A fixed-size ring of per-step undo records. Each record holds only the
+ * 32-bit words of each element that changed during the step, along with
+ * an optional caller-defined block of extra state.
+ */
+
+struct s_hist
+{
+    unsigned int *ring;                 /* Record ring                       */
+    int           size;                 /* Ring size in words                */
+    int           head;                 /* Next word to write                */
+    int           used;                 /* Words in use                      */
+    int           count;                /* Records in use                    */
+
+    unsigned int *temp;                 /* Record scratch                    */
+    int           temp_size;
+
+    struct s_vary_snap prev;            /* State at the latest record        */
+    void              *prev_ext;
+    int                ext_size;
+
+    int bytes;                          /* Bytes recorded since last query   */
+};
+
+int  sol_hist_init(struct s_hist *, const struct s_vary *, int, int);
+void sol_hist_free(struct s_hist *);
+void sol_hist_clear(struct s_hist *, const struct s_vary *, const void *);
+
+int  sol_hist_push(struct s_hist *, const struct s_vary *, const void *);
+int  sol_hist_pop (struct s_hist *, struct s_vary *, void *,
+                   void (*)(const union cmd *));
+
+/*---------------------------------------------------------------------------*/
+
 #endif
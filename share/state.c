@@ -20,6 +20,7 @@
 #include "common.h"
 #include "hmd.h"
 #include "geom.h"
+#include "prof.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -173,6 +174,8 @@ void st_timer(float dt)
     if (!state_drawn)
         return;
 
+    PROF_BEGIN("st_timer");
+
     state_time += dt;
 
     if (state && state->timer)
@@ -192,6 +195,8 @@ void st_timer(float dt)
     /* Step SOL animations. (This is not the best place to put this.) */
 
     geom_step(dt);
+
+    PROF_END();
 }
 
 void st_point(int x, int y, int dx, int dy)
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2014 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thumb.h"
+#include "base_image.h"
+#include "ntx.h"
+#include "hmap.h"
+#include "common.h"
+#include "fs.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define THUMB_SIZE  128                 /* Largest thumbnail side            */
+#define ATLAS_SIZE  1024
+#define ATLAS_SLOTS ((ATLAS_SIZE / THUMB_SIZE) * (ATLAS_SIZE / THUMB_SIZE))
+
+#define THUMB_DIR "Cache/Thumbs"
+
+struct slot
+{
+    char path[MAXSTR];
+    int  w;
+    int  h;
+
+    unsigned int used;                  /* Time of last request              */
+};
+
+static GLuint       atlas;
+static struct slot  slots[ATLAS_SLOTS];
+static unsigned int ticks;
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Name the cached thumbnail of PATH after the file's location and
+ * modification time, so that a changed image gets a new thumbnail.
+ */
+static void thumb_name(char *dst, size_t size, const char *path)
+{
+    const char *real = fs_real_dir(path);
+    char key[MAXSTR * 2];
+
+    snprintf(key, sizeof (key), "%s|%s|%ld", path, real ? real : "",
+             fs_mtime(path));
+
+    snprintf(dst, size, THUMB_DIR "/%08x.ntx", hmap_hash(key));
+}
+
+/*
+ * Expand P, of B channels, to RGBA, the format of the atlas. GLES does not
+ * convert formats on upload. P is released.
+ */
+static void *thumb_rgba(void *p, int w, int h, int b)
+{
+    const unsigned char *s = p;
+    unsigned char *d, *q;
+    int i;
+
+    if (b == 4)
+        return p;
+
+    if ((q = d = malloc(w * h * 4)))
+        for (i = 0; i < w * h; i++, s += b, d += 4)
+        {
+            d[0] = s[0];
+            d[1] = (b < 3) ? s[0] : s[1];
+            d[2] = (b < 3) ? s[0] : s[2];
+            d[3] = (b == 2) ? s[1] : 0xFF;
+        }
+
+    free(p);
+    return q;
+}
+
+/*
+ * Load the thumbnail of PATH as RGBA, making and storing it if needed.
+ */
+static void *thumb_load(const char *path, int *w, int *h)
+{
+    char name[MAXSTR];
+    struct ntx t;
+    void *p, *q;
+    int b, k = 1;
+
+    thumb_name(name, sizeof (name), path);
+
+    if (ntx_read(&t, name))
+    {
+        p  = ntx_decode(&t, 0);
+        *w = t.lv[0].w;
+        *h = t.lv[0].h;
+        b  = t.b;
+
+        ntx_free(&t);
+
+        if (p)
+            return thumb_rgba(p, *w, *h, b);
+    }
+
+    if (!(p = image_load(path, w, h, &b)))
+        return NULL;
+
+    while (*w / k > THUMB_SIZE || *h / k > THUMB_SIZE)
+        k++;
+
+    if (k > 1 && (q = image_scale(p, *w, *h, b, w, h, k)))
+    {
+        free(p);
+        p = q;
+    }
+
+    if (ntx_make(&t, p, *w, *h, b, NTX_RAW))
+    {
+        struct ntx u = t;
+
+        /* Only the base level is ever drawn. */
+
+        u.c = 1;
+
+        fs_mkdir("Cache");
+        fs_mkdir(THUMB_DIR);
+
+        ntx_write(&u, name);
+        ntx_free(&t);
+    }
+    return thumb_rgba(p, *w, *h, b);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void slot_rect(int i, GLfloat rect[4])
+{
+    const int n = ATLAS_SIZE / THUMB_SIZE;
+    const int x = (i % n) * THUMB_SIZE;
+    const int y = (i / n) * THUMB_SIZE;
+
+    rect[0] = (GLfloat) (x)              / ATLAS_SIZE;
+    rect[1] = (GLfloat) (y)              / ATLAS_SIZE;
+    rect[2] = (GLfloat) (x + slots[i].w) / ATLAS_SIZE;
+    rect[3] = (GLfloat) (y + slots[i].h) / ATLAS_SIZE;
+}
+
+static int slot_fill(int i, const char *path)
+{
+    const int n = ATLAS_SIZE / THUMB_SIZE;
+
+    void *p;
+    int w, h;
+
+    if (!(p = thumb_load(path, &w, &h)))
+        return 0;
+
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+                    (i % n) * THUMB_SIZE,
+                    (i / n) * THUMB_SIZE, w, h,
+                    GL_RGBA, GL_UNSIGNED_BYTE, p);
+
+    free(p);
+
+    SAFECPY(slots[i].path, path);
+
+    slots[i].w = w;
+    slots[i].h = h;
+
+    return 1;
+}
+
+static int atlas_init(void)
+{
+    void *p;
+
+    if ((p = calloc(ATLAS_SIZE * ATLAS_SIZE, 4)))
+    {
+        glGenTextures(1, &atlas);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ATLAS_SIZE, ATLAS_SIZE, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, p);
+        free(p);
+
+        memset(slots, 0, sizeof (slots));
+    }
+    return atlas;
+}
+
+/*
+ * Return the atlas texture and the rectangle of the thumbnail of PATH
+ * within it. The least recently requested thumbnail gives way to a new
+ * one when the atlas is full. Return 0 if the image does not load.
+ */
+GLuint thumb_get(const char *path, GLfloat rect[4])
+{
+    GLint o = 0;
+    int i, j = 0;
+
+    if (!path || !*path)
+        return 0;
+
+    if (!atlas && !atlas_init())
+        return 0;
+
+    ticks++;
+
+    for (i = 0; i < ATLAS_SLOTS; i++)
+        if (strcmp(slots[i].path, path) == 0)
+        {
+            slots[i].used = ticks;
+            slot_rect(i, rect);
+            return atlas;
+        }
+
+    for (i = 1; i < ATLAS_SLOTS; i++)
+        if (slots[i].used < slots[j].used)
+            j = i;
+
+    /* Preserve the current binding. */
+
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &o);
+
+    if (slot_fill(j, path))
+    {
+        glBindTexture(GL_TEXTURE_2D, (GLuint) o);
+
+        slots[j].used = ticks;
+        slot_rect(j, rect);
+        return atlas;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, (GLuint) o);
+    return 0;
+}
+
+void thumb_quit(void)
+{
+    if (atlas)
+    {
+        glDeleteTextures(1, &atlas);
+        atlas = 0;
+    }
+    memset(slots, 0, sizeof (slots));
+}
+
+/*---------------------------------------------------------------------------*/
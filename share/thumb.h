@@ -0,0 +1,19 @@
+#ifndef THUMB_H
+#define THUMB_H
+
+#include "glext.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Thumbnails of level shots. Each image is decoded and down-sampled
+ * once, kept in the user directory as an NTX file, and drawn from a
+ * slot in a shared atlas texture.
+ */
+
+GLuint thumb_get(const char *path, GLfloat rect[4]);
+void   thumb_quit(void);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -22,6 +22,8 @@
 #include "config.h"
 #include "gui.h"
 #include "hmd.h"
+#include "state.h"
+#include "frame.h"
 
 extern const char TITLE[];
 extern const char ICON[];
@@ -368,6 +370,9 @@ static int   fps    = 0;
 static int   last   = 0;
 static int   ticks  = 0;
 static int   frames = 0;
+static int   bytes  = 0;
+
+static Uint64 stamp = 0;                /* Performance counter at last swap  */
 
 int  video_perf(void)
 {
@@ -376,6 +381,7 @@ int  video_perf(void)
 
 void video_swap(void)
 {
+    Uint64 now;
     int dt;
 
     glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
@@ -391,6 +397,16 @@ void video_swap(void)
 
     SDL_GL_SwapWindow(window);
 
+    /* Bin the precise time of this frame. */
+
+    now = SDL_GetPerformanceCounter();
+
+    if (stamp)
+        frame_time((float) (1000.0 * (now - stamp) /
+                            SDL_GetPerformanceFrequency()), curr_state());
+
+    stamp = now;
+
     /* Accumulate time passed and frames rendered. */
 
     dt = (int) SDL_GetTicks() - last;
@@ -398,11 +414,14 @@ void video_swap(void)
     frames +=  1;
     ticks  += dt;
     last   += dt;
+    bytes  += gui_upload_bytes();
 
     /* Average over 250ms. */
 
     if (ticks > 1000)
     {
+        struct frame_stat stat;
+
         /* Round the frames-per-second value to the nearest integer. */
 
         double k = 1000.0 * frames / ticks;
@@ -414,15 +433,21 @@ void video_swap(void)
         fps = (int) ((c - k < k - f) ? c : f);
         ms  = (float) ticks / (float) frames;
 
+        /* Output statistics if configured. */
+
+        frame_window(&stat);
+
+        if (config_get_d(CONFIG_STATS))
+            fprintf(stdout, "%4d %8.4f %8d %8.3f %8.3f %8.3f %8.3f %3d\n",
+                    fps, (double) ms, bytes / frames,
+                    (double) stat.p50, (double) stat.p95,
+                    (double) stat.p99, (double) stat.max, stat.over_60);
+
         /* Reset the counters for the next update. */
 
         frames = 0;
         ticks  = 0;
-
-        /* Output statistics if configured. */
-
-        if (config_get_d(CONFIG_STATS))
-            fprintf(stdout, "%4d %8.4f\n", fps, (double) ms);
+        bytes  = 0;
     }
 }
 